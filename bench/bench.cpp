@@ -0,0 +1,375 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+/* Benchmarks of the package list operations on synthetic package sets,
+   see Generator. Each benchmark is repeated for a time budget, the table
+   shows percentiles of the single runs and the throughput at the median. */
+
+#include <algorithm>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/format.hpp>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <ncurses.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "attributeinfo.h"
+#include "curseslistbox.h"
+#include "filter.h"
+#include "frameinfo.h"
+#include "generator.h"
+#include "package.h"
+#include "parallel.h"
+#include "pcursesexception.h"
+#include "profiler.h"
+#include "query.h"
+#include "sortcache.h"
+#include "stringpool.h"
+#include "trigramindex.h"
+
+using std::string;
+using std::vector;
+
+static vector<uint> opt_counts;
+static Generator::Options opt_generator;
+static uint opt_threads = 0;
+static uint opt_budget = 200;
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: pcurses-bench [-h] [-n COUNT]... [-r REPOS] [-d FANOUT] [-s SEED]\n"
+            "                     [-t THREADS] [-m MS]\n"
+            "\n"
+            "-h:            print this message\n"
+            "-n:            number of packages, may be repeated (default 1000, 10000\n"
+            "               and 100000)\n"
+            "-r:            number of repos (default 3)\n"
+            "-d:            average number of dependencies per package (default 4)\n"
+            "-s:            seed of the generated packages (default 1)\n"
+            "-t:            threads for construction, filters and sorts, 0 is one\n"
+            "               per core (default 0)\n"
+            "-m:            time spent on each benchmark in ms (default 200)\n");
+}
+
+static uint parseuint(const char *s)
+{
+    char *end;
+    const unsigned long v = strtoul(s, &end, 10);
+    if (*s == '\0' || *end != '\0') {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    return v;
+}
+
+static void parseargs(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hn:r:d:s:t:m:")) != -1) {
+        switch (opt) {
+        case 'n':
+            opt_counts.push_back(parseuint(optarg));
+            break;
+        case 'r':
+            opt_generator.repos = parseuint(optarg);
+            break;
+        case 'd':
+            opt_generator.fanout = parseuint(optarg);
+            break;
+        case 's':
+            opt_generator.seed = parseuint(optarg);
+            break;
+        case 't':
+            opt_threads = parseuint(optarg);
+            break;
+        case 'm':
+            opt_budget = parseuint(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (opt_counts.empty()) {
+        opt_counts = { 1000, 10000, 100000 };
+    }
+}
+
+static string ms(uint64_t ns)
+{
+    return boost::str(boost::format("%.3f") % (ns / 1e6));
+}
+
+static string rate(double persecond)
+{
+    if (persecond >= 1e6) {
+        return boost::str(boost::format("%.2f M/s") % (persecond / 1e6));
+    }
+    return boost::str(boost::format("%.1f K/s") % (persecond / 1e3));
+}
+
+/* Runs fn until the time budget is used up (at least 3 times), calling
+   setup before each run without timing it. items are the number of things
+   fn works on, for the throughput. */
+static void measure(const string &name, size_t items, const std::function<void()> &setup,
+                    const std::function<void()> &fn)
+{
+    const uint maxruns = 10000;
+    vector<uint64_t> times;
+    uint64_t total = 0,
+             allocs = 0;
+
+    while (times.size() < 3 || (total < opt_budget * 1000000ULL && times.size() < maxruns)) {
+        if (setup) {
+            setup();
+        }
+
+        const uint64_t a = Profiler::allocations();
+        const Profiler::Clock::time_point start = Profiler::Clock::now();
+        fn();
+        const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                Profiler::Clock::now() - start).count();
+        allocs += Profiler::allocations() - a;
+
+        times.push_back(ns);
+        total += ns;
+    }
+
+    std::sort(times.begin(), times.end());
+    const auto percentile = [&times] (uint p) {
+        return times[std::min(times.size() - 1, times.size() * p / 100)];
+    };
+
+    printf("%-30s %5d %10s %10s %10s %10s %12s %9d\n", name.c_str(), (int)times.size(),
+           ms(times.front()).c_str(), ms(percentile(50)).c_str(), ms(percentile(90)).c_str(),
+           ms(percentile(99)).c_str(), rate(items / (percentile(50) / 1e9)).c_str(),
+           (int)(allocs / times.size()));
+    fflush(stdout);
+}
+
+static void construct(const vector<Package::Fields> &fields, uint threads,
+                      vector<StringPool *> &pools, StringPool &lazypool, vector<Package *> &out)
+{
+    while (pools.size() < threads) {
+        pools.push_back(new StringPool());
+    }
+
+    out.assign(fields.size(), NULL);
+    Parallel::for_each_chunk(fields.size(), threads, 256,
+    [&] (size_t begin, size_t end, uint worker) {
+        for (size_t i = begin; i < end; i++) {
+            out[i] = Package::create(fields[i], *pools[worker], lazypool);
+        }
+    });
+}
+
+/* keeps the first package of each name, like repos are prioritized */
+static void dedup(vector<Package *> &packages)
+{
+    std::stable_sort(packages.begin(), packages.end(), [] (const Package *lhs, const Package *rhs) {
+        return Filter::cmp(lhs, rhs, A_NAME);
+    });
+    packages.erase(std::unique(packages.begin(), packages.end(),
+    [] (const Package *lhs, const Package *rhs) {
+        return lhs->getstrattr(A_NAME) == rhs->getstrattr(A_NAME);
+    }), packages.end());
+}
+
+static void releasepools(vector<StringPool *> &pools)
+{
+    for (StringPool *pool : pools) {
+        pool->release();
+    }
+}
+
+static void benchlist(const vector<Package *> &packages)
+{
+    FILE *out = fopen("/dev/null", "w"),
+          *in = fopen("/dev/null", "r");
+    SCREEN *screen = (out != NULL && in != NULL) ? newterm("xterm", out, in) : NULL;
+    if (screen == NULL) {
+        printf("%-30s skipped, no terminal description\n", "list refresh");
+        if (out != NULL) {
+            fclose(out);
+        }
+        if (in != NULL) {
+            fclose(in);
+        }
+        return;
+    }
+
+    {
+        vector<Package *> list = packages;
+        /* the frame takes over its frame info */
+        CursesListBox box(new FrameInfo(FE_LIST, 160, 50));
+        box.setlist(&list);
+
+        const int rows = box.usableheight() + 1;
+        measure("list refresh (page down)", rows, std::function<void()>(), [&] () {
+            if (box.focusedindex() + rows >= (int)list.size()) {
+                box.moveabs(0);
+            } else {
+                box.move(rows);
+            }
+            box.refresh();
+            doupdate();
+        });
+        measure("list refresh (all rows)", rows, std::function<void()>(), [&] () {
+            box.invalidate();
+            box.refresh();
+            doupdate();
+        });
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(out);
+    fclose(in);
+}
+
+static void bench(uint count, uint threads)
+{
+    Generator::Options o = opt_generator;
+    o.count = count;
+
+    StringPool fieldpool, lazypool;
+    vector<Package::Fields> fields;
+    Generator(o).generate(fieldpool, fields);
+
+    printf("\n%d packages, %d repo entries, %d threads\n\n", count, (int)fields.size(), threads);
+    printf("%-30s %5s %10s %10s %10s %10s %12s %9s\n", "benchmark", "runs", "min ms", "p50 ms",
+           "p90 ms", "p99 ms", "throughput", "allocs");
+
+    vector<StringPool *> pools;
+    vector<Package *> packages;
+
+    measure("construct", fields.size(), [&] () {
+        releasepools(pools);
+    }, [&] () {
+        construct(fields, threads, pools, lazypool, packages);
+    });
+
+    const vector<Package *> constructed = packages;
+    measure("dedup", constructed.size(), [&] () {
+        packages = constructed;
+    }, [&] () {
+        dedup(packages);
+    });
+
+    for (uint i = 0; i < packages.size(); i++) {
+        packages[i]->setindex(i);
+    }
+
+    boost::dynamic_bitset<> all(packages.size()), mask(packages.size());
+    all.set();
+
+    const char *matches[][2] = {
+        { "match phrase", "kalo" },
+        { "match regex", "n:^lib.*(ka|lo)$" },
+        { "match install state", "t:explicit" }
+    };
+    for (const auto &m : matches) {
+        const Query query(m[1]);
+        measure(m[0], packages.size(), std::function<void()>(), [&] () {
+            size_t n = 0;
+            for (const Package *p : packages) {
+                n += query.matches(p);
+            }
+            mask[0] = n & 1;
+        });
+    }
+
+    TrigramIndex index;
+    measure("build trigram index", packages.size(), std::function<void()>(), [&] () {
+        index.build(packages);
+    });
+
+    const Query phrase("kalo");
+    measure("filter phrase (index)", packages.size(), std::function<void()>(), [&] () {
+        mask.reset();
+        phrase.select(packages, all, &index, threads, mask);
+    });
+
+    /* each filter only looks at what passed the previous ones */
+    const char *chain[] = { "lib", "r:repo[01]", "d!:update available" };
+    measure("chained filters", packages.size(), std::function<void()>(), [&] () {
+        boost::dynamic_bitset<> base = all;
+        for (const char *q : chain) {
+            mask.reset();
+            Query(q).select(packages, base, &index, threads, mask);
+            base.swap(mask);
+        }
+    });
+
+    SortCache cache;
+    cache.setparallel(threads, 8192);
+    for (int a = 0; a < A_NONE; a++) {
+        measure("sort " + AttributeInfo::attrname((AttributeEnum)a), packages.size(), [&] () {
+            cache.reset(packages);
+        }, [&] () {
+            cache.sorted((AttributeEnum)a);
+        });
+    }
+
+    const AttributeEnum colorattrs[] = {
+        A_REPO, A_INSTALLSTATE, A_UPDATESTATE, A_PACKAGER, A_LICENSES, A_ARCH, A_GROUPS
+    };
+    for (AttributeEnum a : colorattrs) {
+        measure("colorcode " + AttributeInfo::attrname(a), packages.size(), [&] () {
+            cache.reset(packages);
+        }, [&] () {
+            cache.groups(a);
+        });
+    }
+
+    /* colored by repo, like the default startup macro */
+    cache.reset(packages);
+    Package::setcolresolver([&cache] (const Package * p) {
+        return cache.groups(A_REPO)[p->getindex()];
+    });
+    benchlist(cache.sorted(A_NAME));
+    Package::setcolresolver(std::function<int(const Package *)>());
+
+    for (StringPool *pool : pools) {
+        delete pool;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parseargs(argc, argv);
+
+    const uint threads = Parallel::threadcount(opt_threads);
+
+    try {
+        for (uint count : opt_counts) {
+            bench(count, threads);
+        }
+    } catch (const PcursesException &e) {
+        std::cerr << e.getmessage() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
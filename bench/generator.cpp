@@ -0,0 +1,208 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "generator.h"
+
+#include <boost/format.hpp>
+#include <cmath>
+#include <ctime>
+#include <random>
+#include <string>
+
+#include "stringpool.h"
+
+using boost::string_ref;
+using std::string;
+using std::vector;
+
+/* all start with different letters, so that names made of them are unique */
+static const char *syllables[] = {
+    "ka", "lo", "mi", "nu", "pe", "ra", "si", "to",
+    "vu", "xe", "yo", "ze", "bar", "dun", "fil", "gor"
+};
+static const char *prefixes[] = {
+    "", "", "", "", "", "lib", "lib", "python-", "perl-", "lib32-", "ttf-", "haskell-"
+};
+static const char *words[] = {
+    "library", "tool", "for", "the", "fast", "simple", "system", "data",
+    "network", "graphics", "bindings", "utilities", "daemon", "font", "editor",
+    "client", "server", "parser", "and", "with", "python", "perl", "gtk", "qt",
+    "x11", "linux", "command", "line", "interface", "to", "a", "of"
+};
+static const char *licenses[] = {
+    "GPL", "GPL2", "GPL3", "LGPL", "MIT", "BSD", "Apache", "custom", "GPL2 LGPL2.1"
+};
+static const char *groups[] = {
+    "base-devel", "xorg", "gnome", "kde-applications", "texlive-most"
+};
+static const char *arches[] = { "x86_64", "any" };
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
+
+Generator::Options::Options()
+    : count(10000), repos(3), fanout(4), descwords(8), seed(1),
+      overlap(0.05), installed(0.1), updates(0.05), provides(0.02)
+{
+}
+
+Generator::Generator(const Options &o)
+    : opts(o)
+{
+    if (opts.repos == 0) {
+        opts.repos = 1;
+    }
+}
+
+static string pkgname(uint i)
+{
+    string name = prefixes[i % COUNTOF(prefixes)];
+    uint v = i / COUNTOF(prefixes);
+    for (int s = 0; s < 2 || v != 0; s++) {
+        name += syllables[v % COUNTOF(syllables)];
+        v /= COUNTOF(syllables);
+    }
+    return name;
+}
+
+static string datestr(time_t t)
+{
+    char timestr[32];
+    if (ctime_r(&t, timestr) == NULL) {
+        return "";
+    }
+    string s = timestr;
+    return s.substr(0, s.find('\n'));
+}
+
+void Generator::generate(StringPool &pool, vector<Package::Fields> &out) const
+{
+    std::mt19937 rng(opts.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const auto chance = [&rng, &unit] (double p) {
+        return unit(rng) < p;
+    };
+    const auto pick = [&rng] (size_t n) {
+        return (size_t)(rng() % n);
+    };
+
+    const uint virtuals = std::max<uint>(1, opts.count * opts.provides / 4);
+    vector<vector<Package::Fields> > byrepo(opts.repos);
+
+    for (uint i = 0; i < opts.count; i++) {
+        Package::Fields f;
+
+        f.name = pool.store(pkgname(i));
+        f.lname = pool.lower(f.name);
+        f.url = pool.store("https://example.org/" + f.name.to_string());
+        const uint packager = pick(50);
+        f.packager = pool.intern(boost::str(boost::format("Packager %d <p%d@example.org>")
+                                            % packager % packager));
+        f.arch = pool.intern(arches[pick(COUNTOF(arches))]);
+        f.licenses = pool.intern(licenses[pick(COUNTOF(licenses))]);
+        f.groups = pool.intern(chance(0.1) ? groups[pick(COUNTOF(groups))] : "");
+        f.signature = pool.intern(Package::signaturetostr(chance(0.9)));
+
+        string desc;
+        const uint nwords = opts.descwords / 2 + pick(opts.descwords + 1);
+        for (uint w = 0; w < nwords; w++) {
+            string word = words[pick(COUNTOF(words))];
+            if (w == 0) {
+                word[0] = toupper(word[0]);
+            } else {
+                desc += " ";
+            }
+            desc += word;
+        }
+        f.desc = pool.store(desc);
+        f.ldesc = pool.lower(f.desc);
+
+        /* log-uniform, from a few KB to a few hundred MB */
+        f.size = std::exp(8.0 + 12.0 * unit(rng));
+        f.installsize = f.size * (1.5 + 2.5 * unit(rng));
+        f.sizestr = pool.intern(Package::size2str(f.size));
+        f.installsizestr = pool.intern(Package::size2str(f.installsize));
+        f.builddate = 1300000000 + (int64_t)(400000000 * unit(rng));
+        f.builddatestr = pool.store(datestr(f.builddate));
+
+        /* dependencies mostly go to a few popular packages */
+        string depends;
+        const uint ndeps = pick(2 * opts.fanout + 1);
+        for (uint d = 0; d < ndeps; d++) {
+            const uint t = opts.count * std::pow(unit(rng), 3);
+            if (t == i) {
+                continue;
+            }
+            if (!depends.empty()) {
+                depends += " ";
+            }
+            depends += pkgname(t) + (chance(0.2) ? ">=1.0" : "");
+        }
+        if (chance(opts.provides)) {
+            depends += (depends.empty() ? "" : " ") +
+                       boost::str(boost::format("virtual%d") % pick(virtuals));
+        }
+        f.depends = pool.store(depends);
+        f.optdepends = pool.store(chance(0.1) ?
+                                  pkgname(pick(opts.count)) + ": for extra features" : "");
+        f.conflicts = pool.store(chance(0.01) ? pkgname(pick(opts.count)) : "");
+        f.replaces = pool.store(chance(0.01) ? pkgname(pick(opts.count)) : "");
+        f.provides = pool.store(chance(opts.provides) ?
+                                boost::str(boost::format("virtual%d=1.0") % (i % virtuals)) : "");
+
+        const string version = boost::str(boost::format("%s%d.%d.%d-%d")
+                                          % (chance(0.05) ? "1:" : "") % pick(20) % pick(30)
+                                          % pick(10) % (1 + pick(5)));
+        const string older = version.substr(0, version.rfind('-')) + "-0";
+        f.version = pool.store(version);
+
+        if (chance(opts.installed)) {
+            f.reason = chance(0.4) ? IRE_EXPLICIT : IRE_ASDEPS;
+            if (chance(opts.updates)) {
+                f.updatestate = USE_UPDATEAVAILABLE;
+                f.localversion = pool.store(older);
+                f.versionstr = pool.store(version + " (local: " + older + ")");
+            } else {
+                f.updatestate = USE_UPTODATE;
+                f.localversion = f.version;
+                f.versionstr = f.version;
+            }
+        } else {
+            f.reason = IRE_NOTINSTALLED;
+            f.updatestate = USE_NOTINSTALLED;
+            f.localversion = string_ref();
+            f.versionstr = f.version;
+        }
+
+        const uint repo = pick(opts.repos);
+        f.dbname = pool.intern(boost::str(boost::format("repo%d") % repo));
+        byrepo[repo].push_back(f);
+
+        /* the same package, one version behind, in the next repo */
+        if (opts.repos > 1 && chance(opts.overlap)) {
+            const uint next = (repo + 1) % opts.repos;
+            f.dbname = pool.intern(boost::str(boost::format("repo%d") % next));
+            f.version = pool.store(older);
+            f.versionstr = f.version;
+            byrepo[next].push_back(f);
+        }
+    }
+
+    out.clear();
+    for (const vector<Package::Fields> &r : byrepo) {
+        out.insert(out.end(), r.begin(), r.end());
+    }
+}
@@ -0,0 +1,58 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <sys/types.h>
+#include <vector>
+
+#include "package.h"
+
+class StringPool;
+
+/* Generates synthetic package sets as plain values, which
+   Package::create(const Package::Fields &, ...) consumes without libalpm.
+   The same options always produce the same packages. */
+class Generator
+{
+public:
+    struct Options {
+        Options();
+
+        uint count,         /* distinct package names */
+             repos,         /* sync repos the packages are spread over */
+             fanout,        /* average number of dependencies */
+             descwords,     /* average number of words per description */
+             seed;
+        double overlap,     /* share of packages which are in a second repo */
+               installed,   /* share of packages which are installed */
+               updates,     /* share of installed packages with an update */
+               provides;    /* share of packages providing a virtual package */
+    };
+
+    explicit Generator(const Options &o);
+
+    /* Stores the fields of all repo entries in out, in repo order. Packages
+       in several repos occur once per repo. All strings are stored in pool. */
+    void generate(StringPool &pool, std::vector<Package::Fields> &out) const;
+
+private:
+    Options opts;
+};
+
+#endif // GENERATOR_H
@@ -48,6 +48,8 @@ AttributeEnum AttributeInfo::chartoattr(char c)
         return A_PACKAGER;
     case 'l':
         return A_LICENSES;
+    case 'm':
+        return A_ROOTS;
     case 'n':
         return A_NAME;
     case 'o':
@@ -122,6 +124,8 @@ string AttributeInfo::attrname(AttributeEnum attr)
         return "Optionally required by";
     case A_REPO:
         return "Repo";
+    case A_ROOTS:
+        return "Root comparison";
     case A_SIGNATURE:
         return "Signature";
     case A_SIZE:
@@ -138,3 +142,71 @@ string AttributeInfo::attrname(AttributeEnum attr)
         throw PcursesException("Invalid attribute passed.");
     }
 }
+
+AttributeEnum AttributeInfo::keytoattr(const string &key)
+{
+    for (int i = A_NAME; i < A_NONE; i++) {
+        if (attrkey((AttributeEnum)i) == key) {
+            return (AttributeEnum)i;
+        }
+    }
+
+    /* the single chars used in queries work as well */
+    return (key.length() == 1) ? chartoattr(key[0]) : A_NONE;
+}
+
+string AttributeInfo::attrkey(AttributeEnum attr)
+{
+    switch (attr) {
+    case A_ARCH:
+        return "arch";
+    case A_BUILDDATE:
+        return "builddate";
+    case A_CONFLICTS:
+        return "conflicts";
+    case A_DEPENDS:
+        return "depends";
+    case A_DESC:
+        return "desc";
+    case A_GROUPS:
+        return "groups";
+    case A_INSTALLSTATE:
+        return "installstate";
+    case A_ISIZE:
+        return "isize";
+    case A_LICENSES:
+        return "licenses";
+    case A_NAME:
+        return "name";
+    case A_OPTDEPENDS:
+        return "optdepends";
+    case A_PACKAGER:
+        return "packager";
+    case A_PROVIDES:
+        return "provides";
+    case A_REPLACES:
+        return "replaces";
+    case A_REQUIREDBY:
+        return "requiredby";
+    case A_OPTIONALFOR:
+        return "optionalfor";
+    case A_REPO:
+        return "repo";
+    case A_ROOTS:
+        return "roots";
+    case A_SIGNATURE:
+        return "signature";
+    case A_SIZE:
+        return "size";
+    case A_UPDATESTATE:
+        return "updatestate";
+    case A_URL:
+        return "url";
+    case A_VERSION:
+        return "version";
+    case A_NONE:
+        return "";
+    default:
+        throw PcursesException("Invalid attribute passed.");
+    }
+}
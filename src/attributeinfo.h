@@ -45,6 +45,8 @@ enum AttributeEnum {
     A_SIZE,
     A_ISIZE,
     A_OPTDEPENDS,
+    /* installed versions in all roots, see Program::updaterootinfo() */
+    A_ROOTS,
     A_NONE
 };
 
@@ -54,6 +56,11 @@ public:
     static AttributeEnum chartoattr(char c);
     static char attrtochar(AttributeEnum attr);
     static std::string attrname(AttributeEnum attr);
+
+    /* lower case identifiers (for example "isize"), used for output
+       columns and field names */
+    static AttributeEnum keytoattr(const std::string &key);
+    static std::string attrkey(AttributeEnum attr);
 };
 
 #endif // ATTRIBUTEINFO_H
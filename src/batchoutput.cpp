@@ -0,0 +1,113 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+#include "batchoutput.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include "package.h"
+#include "pcursesexception.h"
+
+using std::string;
+using std::vector;
+
+BatchOutput::BatchOutput(FILE *out, const string &columns, bool json)
+    : out(out), json(json)
+{
+    vector<string> strs;
+    boost::split(strs, columns, boost::is_any_of(","));
+
+    for (string &s : strs) {
+        boost::trim(s);
+        if (s.empty()) {
+            continue;
+        }
+
+        const AttributeEnum attr = AttributeInfo::keytoattr(s);
+        if (attr == A_NONE) {
+            throw PcursesException("unknown output column: " + s);
+        }
+        this->columns.push_back(attr);
+        keys.push_back(AttributeInfo::attrkey(attr));
+    }
+
+    if (this->columns.empty()) {
+        throw PcursesException("no output columns given");
+    }
+}
+
+void BatchOutput::writeescaped(boost::string_ref str)
+{
+    for (const char c : str) {
+        switch (c) {
+        case '\\':
+            line += "\\\\";
+            break;
+        case '\t':
+            line += "\\t";
+            break;
+        case '\n':
+            line += "\\n";
+            break;
+        case '\r':
+            line += "\\r";
+            break;
+        case '"':
+            line += json ? "\\\"" : "\"";
+            break;
+        default:
+            if (json && (unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                line += buf;
+            } else {
+                line += c;
+            }
+            break;
+        }
+    }
+}
+
+void BatchOutput::write(const Package *pkg)
+{
+    line.clear();
+
+    if (json) {
+        line += '{';
+    }
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (json) {
+            line += (i == 0) ? "\"" : ",\"";
+            line += keys[i];
+            line += "\":\"";
+            writeescaped(pkg->getstrattr(columns[i]));
+            line += '"';
+        } else {
+            if (i != 0) {
+                line += '\t';
+            }
+            writeescaped(pkg->getstrattr(columns[i]));
+        }
+    }
+
+    if (json) {
+        line += '}';
+    }
+    line += '\n';
+
+    fwrite(line.data(), 1, line.length(), out);
+}
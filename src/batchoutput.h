@@ -0,0 +1,54 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+#ifndef BATCHOUTPUT_H
+#define BATCHOUTPUT_H
+
+#include <boost/utility/string_ref.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "attributeinfo.h"
+
+class Package;
+
+/* Writes packages to a stream in batch mode (see Program::runbatch()), one
+   line per package: tab separated values, or a JSON object per line. Only
+   the requested attributes are looked at, so fields computed on demand are
+   left alone otherwise. */
+class BatchOutput
+{
+public:
+    /* columns is a comma separated list of attribute keys (see
+       AttributeInfo::keytoattr()), throws if one is unknown */
+    BatchOutput(FILE *out, const std::string &columns, bool json);
+
+    void write(const Package *pkg);
+
+private:
+    void writeescaped(boost::string_ref str);
+
+    FILE *out;
+    std::vector<AttributeEnum> columns;
+    std::vector<std::string> keys;
+    bool json;
+
+    /* reused for every line */
+    std::string line;
+};
+
+#endif // BATCHOUTPUT_H
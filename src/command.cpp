@@ -0,0 +1,328 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "command.h"
+
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <chrono>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "eventloop.h"
+#include "pcursesexception.h"
+
+#define PIPE_READ 0
+#define PIPE_WRITE 1
+
+using std::string;
+using std::vector;
+
+/* output beyond this is dropped, a line at a time */
+static const size_t MAXLINE = 4096;
+
+/* how long a cancelled command may take to clean up before it is killed */
+static const int KILL_GRACE_MS = 2000;
+
+/* True if line contains anything bash would treat specially. A '=' only
+   matters in the first word, where it makes an assignment. */
+static bool needsshell(const string &line)
+{
+    if (line.find_first_of("|&;<>()$`\\\"'*?[]#~!{}\n") != string::npos) {
+        return true;
+    }
+
+    const size_t first = line.find_first_not_of(" \t");
+    if (first == string::npos) {
+        return false;
+    }
+    const size_t last = line.find_first_of(" \t", first);
+
+    return line.substr(first, last - first).find('=') != string::npos;
+}
+
+void Command::prepare(const string &line, Args &args)
+{
+    args.line = line;
+    args.words.clear();
+    args.argv.clear();
+
+    if (needsshell(line)) {
+        return;
+    }
+
+    const string trimmed = boost::trim_copy(line);
+    if (trimmed.empty()) {
+        return;
+    }
+    boost::split(args.words, trimmed, boost::is_any_of(" \t"), boost::token_compress_on);
+
+    for (string &word : args.words) {
+        args.argv.push_back(&word[0]);
+    }
+    args.argv.push_back(NULL);
+}
+
+void Command::exec(const Args &args, bool interactive)
+{
+    if (!args.argv.empty()) {
+        execvp(args.argv[0], args.argv.data());
+    }
+
+    /* needs the shell, or is not a program (but maybe an alias) */
+    execlp("bash", "bash", interactive ? "-ic" : "-c", args.line.c_str(), (char *)NULL);
+    _exit(127);
+}
+
+Command::Command()
+    : pid(-1), started(false), cancelled(false), finished(false), status(0)
+{
+    cancelfds[PIPE_READ] = cancelfds[PIPE_WRITE] = -1;
+}
+
+Command::~Command()
+{
+    stop();
+}
+
+void Command::start(const string &line)
+{
+    stop();
+
+    Args args;
+    prepare(line, args);
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        throw PcursesException("failed to create output pipe");
+    }
+    if (pipe2(cancelfds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        close(fds[PIPE_READ]);
+        close(fds[PIPE_WRITE]);
+        throw PcursesException("failed to create cancel pipe");
+    }
+
+    const pid_t child = fork();
+    if (child == -1) {
+        close(fds[PIPE_READ]);
+        close(fds[PIPE_WRITE]);
+        close(cancelfds[PIPE_READ]);
+        close(cancelfds[PIPE_WRITE]);
+        cancelfds[PIPE_READ] = cancelfds[PIPE_WRITE] = -1;
+        throw PcursesException("fork() failed");
+    }
+
+    if (child == 0) {
+        /* keep it away from the terminal, it would mess up the screen and
+           receive our ^C */
+        setsid();
+        const int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        dup2(devnull, STDIN_FILENO);
+        dup2(fds[PIPE_WRITE], STDOUT_FILENO);
+        dup2(fds[PIPE_WRITE], STDERR_FILENO);
+        exec(args, false);
+    }
+
+    close(fds[PIPE_WRITE]);
+
+    pid = child;
+    started = true;
+    cancelled = false;
+    finished = false;
+    status = 0;
+    lines.clear();
+    reader = std::thread(&Command::work, this, fds[PIPE_READ]);
+}
+
+bool Command::busy() const
+{
+    return started;
+}
+
+bool Command::poll(vector<string> &out, string &desc)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (string &line : lines) {
+            out.push_back(string());
+            out.back().swap(line);
+        }
+        lines.clear();
+
+        if (!started || !finished) {
+            return false;
+        }
+    }
+
+    reader.join();
+    close(cancelfds[PIPE_READ]);
+    close(cancelfds[PIPE_WRITE]);
+    cancelfds[PIPE_READ] = cancelfds[PIPE_WRITE] = -1;
+    started = false;
+
+    if (WIFEXITED(status)) {
+        desc = boost::str(boost::format("exit status %d") % WEXITSTATUS(status));
+    } else if (WIFSIGNALED(status)) {
+        desc = boost::str(boost::format("killed by signal %d") % WTERMSIG(status));
+    } else {
+        desc = "exited";
+    }
+
+    return true;
+}
+
+void Command::cancel()
+{
+    if (!started || cancelled) {
+        return;
+    }
+
+    /* the reader signals the command, it knows whether it has been reaped */
+    const char c = 0;
+    if (write(cancelfds[PIPE_WRITE], &c, 1) == -1) {
+        /* the pipe is full, so the reader has been told already */
+    }
+    cancelled = true;
+}
+
+void Command::stop()
+{
+    if (!started) {
+        return;
+    }
+
+    cancel();
+    reader.join();
+
+    close(cancelfds[PIPE_READ]);
+    close(cancelfds[PIPE_WRITE]);
+    cancelfds[PIPE_READ] = cancelfds[PIPE_WRITE] = -1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    started = false;
+    finished = false;
+    lines.clear();
+}
+
+void Command::addline(string &line)
+{
+    lines.push_back(string());
+    lines.back().swap(line);
+}
+
+void Command::work(int fd)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    char buf[4096];
+    string line;
+    bool cr = false,
+         terminated = false,
+         killed = false;
+    Clock::time_point killat;
+
+    for (;;) {
+        struct pollfd pfds[2] = {
+            { fd, POLLIN, 0 },
+            { cancelfds[PIPE_READ], POLLIN, 0 }
+        };
+
+        int timeout = -1;
+        if (terminated && !killed) {
+            const Clock::duration left = killat - Clock::now();
+            timeout = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(left).count());
+        }
+
+        const int ret = ::poll(pfds, 2, timeout);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        /* the command is the leader of its own process group, and it has
+           not been reaped yet */
+        if (pfds[1].revents != 0 && !terminated) {
+            kill(-pid, SIGTERM);
+            terminated = true;
+            killat = Clock::now() + std::chrono::milliseconds(KILL_GRACE_MS);
+            while (read(cancelfds[PIPE_READ], buf, sizeof(buf)) > 0) { }
+            continue;
+        }
+        if (ret == 0) {
+            kill(-pid, SIGKILL);
+            killed = true;
+            continue;
+        }
+        if (pfds[0].revents == 0) {
+            continue;
+        }
+
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ssize_t i = 0; i < n; i++) {
+            const char c = buf[i];
+
+            /* a lone carriage return starts the line over, as progress
+               bars do */
+            if (cr && c != '\n') {
+                line.clear();
+            }
+            cr = false;
+
+            if (c == '\n') {
+                addline(line);
+            } else if (c == '\r') {
+                cr = true;
+            } else if (line.length() >= MAXLINE) {
+                continue;
+            } else if (c == '\t') {
+                line.append(8 - line.length() % 8, ' ');
+            } else if (!iscntrl((unsigned char)c)) {
+                line += c;
+            }
+        }
+        EventLoop::wakeup();
+    }
+    close(fd);
+
+    int st = 0;
+    while (waitpid(pid, &st, 0) == -1 && errno == EINTR) { }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!line.empty()) {
+        addline(line);
+    }
+    status = st;
+    finished = true;
+    EventLoop::wakeup();
+}
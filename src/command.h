@@ -0,0 +1,97 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+/* Runs commands entered by the user. Commands without any shell syntax are
+   executed directly, all others (and commands which are not found, such as
+   aliases) by bash.
+
+   A Command object runs one command in the background and collects its
+   output line by line, the main thread picks it up using poll(). */
+class Command
+{
+public:
+    /* Everything exec() needs, prepared before forking. */
+    struct Args {
+        std::string line;
+        /* empty if the line needs a shell */
+        std::vector<std::string> words;
+        std::vector<char *> argv;
+    };
+
+    static void prepare(const std::string &line, Args &args);
+
+    /* Replaces the current process by the command. bash is started as an
+       interactive shell if requested, so that aliases and the like work.
+       Meant to be called right after fork(), it only uses async signal safe
+       functions. */
+    static void exec(const Args &args, bool interactive) __attribute__((noreturn));
+
+    Command();
+    ~Command();
+
+    /* Starts line in its own session, with stdin connected to /dev/null and
+       stdout and stderr to the output. Only one command may run at a time. */
+    void start(const std::string &line);
+
+    /* True from start() until poll() has returned true. */
+    bool busy() const;
+
+    /* Moves all output lines read since the last call to lines. Returns true
+       once the command has exited and all of its output has been taken,
+       status then describes how it exited. */
+    bool poll(std::vector<std::string> &lines, std::string &status);
+
+    /* Asks the command, including everything it started, to terminate and
+       kills it if it is still around after a grace period. Returns right
+       away, poll() tells once it is gone. */
+    void cancel();
+
+    /* Like cancel(), but waits for the command to exit. */
+    void stop();
+
+private:
+    Command(const Command &);
+    Command &operator=(const Command &);
+
+    void work(int fd);
+    void addline(std::string &line);
+
+    std::thread reader;
+    std::mutex mutex;
+
+    /* tells the reader to terminate the command */
+    int cancelfds[2];
+
+    pid_t pid;
+    bool started,
+         cancelled,
+         finished;
+    int status;
+
+    std::vector<std::string> lines;
+};
+
+#endif // COMMAND_H
@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/xpressive/xpressive.hpp>
 #include <fstream>
 #include <iostream>
@@ -41,6 +42,15 @@ Config::Config()
     rootdir = "/";
     dbpath = "/var/lib/pacman";
     logfile = "/var/log/pacman.log";
+    loadthreads = 0;
+    lazyfields = true;
+    searchindex = true;
+    livefilter = true;
+    snapshot = true;
+    showlatency = false;
+    parallelthreshold = 8192;
+    filtercache = 16;
+    autoreload = false;
 }
 
 Config::~Config()
@@ -61,17 +71,33 @@ string Config::getconfvalue(const string str) const
 
 void Config::parse_pcursesconf()
 {
+    const string s_loadthreads = "LoadThreads",
+                 s_lazyfields = "LazyFields",
+                 s_searchindex = "SearchIndex",
+                 s_parallelthreshold = "ParallelThreshold",
+                 s_livefilter = "LiveFilter",
+                 s_snapshot = "Snapshot",
+                 s_showlatency = "ShowLatency",
+                 s_filtercache = "FilterCache",
+                 s_root = "Root",
+                 s_autoreload = "AutoReload";
     std::ifstream conf;
     sregex macro = sregex::compile("^([^#]\\w*?)=(.+)$");
     sregex comment = sregex::compile("^#");
+    sregex secrex = sregex::compile("^\\[(\\w+)\\].*$");
     smatch what;
 
+    /* parsed again on every full reload */
+    roots.clear();
+
     conf.open(pcursesconffile.c_str());
     if (!conf.is_open()) {
         /* ignore missing conf file */
         return;
     }
 
+    /* lines before the first section header are macros */
+    ConfSection section = CS_MACROS;
     while (conf.good()) {
         string line;
         std::getline(conf, line);
@@ -82,12 +108,61 @@ void Config::parse_pcursesconf()
 
         if (regex_match(line, what, comment)) {
             continue;
+        } else if (regex_match(line, what, secrex)) {
+            section = (what[1] == "options") ? CS_OPTIONS : CS_MACROS;
+        } else if (section == CS_OPTIONS) {
+            if (boost::starts_with(line, s_loadthreads)) {
+                loadthreads = parseuint(getconfvalue(line), s_loadthreads);
+            } else if (boost::starts_with(line, s_lazyfields)) {
+                lazyfields = parsebool(getconfvalue(line), s_lazyfields);
+            } else if (boost::starts_with(line, s_searchindex)) {
+                searchindex = parsebool(getconfvalue(line), s_searchindex);
+            } else if (boost::starts_with(line, s_parallelthreshold)) {
+                parallelthreshold = parseuint(getconfvalue(line), s_parallelthreshold);
+            } else if (boost::starts_with(line, s_livefilter)) {
+                livefilter = parsebool(getconfvalue(line), s_livefilter);
+            } else if (boost::starts_with(line, s_snapshot)) {
+                snapshot = parsebool(getconfvalue(line), s_snapshot);
+            } else if (boost::starts_with(line, s_showlatency)) {
+                showlatency = parsebool(getconfvalue(line), s_showlatency);
+            } else if (boost::starts_with(line, s_filtercache)) {
+                filtercache = parseuint(getconfvalue(line), s_filtercache);
+            } else if (boost::starts_with(line, s_autoreload)) {
+                autoreload = parsebool(getconfvalue(line), s_autoreload);
+            } else if (boost::starts_with(line, s_root)) {
+                roots.push_back(getconfvalue(line));
+            }
         } else if (regex_match(line, what, macro)) {
             macros.insert(std::pair<string, string>(what[1], what[2]));
         }
     }
 }
 
+uint Config::parseuint(const string &value, const string &option) const
+{
+    /* lexical_cast wraps negative numbers around */
+    if (boost::starts_with(value, "-")) {
+        throw PcursesException(option + " expects a non-negative number.");
+    }
+
+    try {
+        return boost::lexical_cast<uint>(value);
+    } catch (const boost::bad_lexical_cast &) {
+        throw PcursesException(option + " expects a non-negative number.");
+    }
+}
+
+bool Config::parsebool(const string &value, const string &option) const
+{
+    if (value == "yes" || value == "true" || value == "1") {
+        return true;
+    } else if (value == "no" || value == "false" || value == "0") {
+        return false;
+    }
+
+    throw PcursesException(option + " expects yes or no.");
+}
+
 void Config::parse_pacmanconf()
 {
     const string s_rootdir = "RootDir",
@@ -97,6 +172,9 @@ void Config::parse_pacmanconf()
     sregex secrex = sregex::compile("^\\[(\\w+)\\].*$");
     smatch what;
 
+    /* parsed again on every reload */
+    repos.clear();
+
     conf.open(pacmanconffile.c_str());
     if (!conf.is_open()) {
         throw PcursesException("pacman.conf could not be read.");
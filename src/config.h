@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <sys/types.h>
 
 class Config
 {
@@ -66,14 +67,68 @@ public:
         return repos;
     }
 
+    /* other roots (chroots, containers) whose installed packages are compared
+       to the ones of rootdir */
+    std::vector<std::string> getroots() const
+    {
+        return roots;
+    }
+
     std::map<std::string, std::string> getmacros() const
     {
         return macros;
     }
 
+    uint getloadthreads() const
+    {
+        return loadthreads;
+    }
+
+    bool getlazyfields() const
+    {
+        return lazyfields;
+    }
+
+    bool getsearchindex() const
+    {
+        return searchindex;
+    }
+
+    uint getparallelthreshold() const
+    {
+        return parallelthreshold;
+    }
+
+    bool getlivefilter() const
+    {
+        return livefilter;
+    }
+
+    bool getsnapshot() const
+    {
+        return snapshot;
+    }
+
+    bool getshowlatency() const
+    {
+        return showlatency;
+    }
+
+    uint getfiltercache() const
+    {
+        return filtercache;
+    }
+
+    bool getautoreload() const
+    {
+        return autoreload;
+    }
+
 private:
 
     std::string getconfvalue(const std::string) const;
+    uint parseuint(const std::string &value, const std::string &option) const;
+    bool parsebool(const std::string &value, const std::string &option) const;
 
     std::string pacmanconffile,
         pcursesconffile,
@@ -81,14 +136,26 @@ private:
         dbpath,
         logfile;
 
-    std::vector<std::string> repos;
+    std::vector<std::string> repos,
+        roots;
 
     std::map<std::string, std::string> macros;
 
+    uint loadthreads,
+         parallelthreshold,
+         filtercache;
+    bool lazyfields,
+         searchindex,
+         livefilter,
+         snapshot,
+         showlatency,
+         autoreload;
+
     enum ConfSection {
         CS_NONE,
         CS_OPTIONS,
-        CS_REPO
+        CS_REPO,
+        CS_MACROS
     };
 };
 
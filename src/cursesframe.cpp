@@ -19,10 +19,13 @@
 
 #include "frameinfo.h"
 
+using boost::string_ref;
 using std::string;
 
 CursesFrame::CursesFrame(FrameInfo *frameinfo)
-    : overflowind("..."), w_main(NULL), w_border(NULL), focused(false), finfo(frameinfo)
+    : overflowind("..."), w_main(NULL), w_border(NULL), focused(false),
+      dirty(true), borderdirty(true), redrawnborder(false), drawnfocused(false),
+      finfo(frameinfo)
 {
     if (finfo->gethasborder()) {
         w_border = newwin(finfo->geth(), finfo->getw(), finfo->gety(), finfo->getx());
@@ -65,11 +68,24 @@ void CursesFrame::reposition(int termw, int termh)
         wresize(w_main, finfo->geth(), finfo->getw());
         mvwin(w_main, finfo->gety(), finfo->getx());
     }
+
+    invalidate();
 }
 
-string CursesFrame::fitstrtowin(string in, int x) const
+void CursesFrame::invalidate()
+{
+    dirty = true;
+    borderdirty = true;
+    touchwin(w_main);
+}
+
+void CursesFrame::invalidateborder()
+{
+    borderdirty = true;
+}
+
+string_ref CursesFrame::fitstrtowin(string_ref in, int x) const
 {
-    in = escapestring(in);
     int len = in.length();
 
     if (len == 0 || in[len - 1] != '\n') {
@@ -86,55 +102,80 @@ string CursesFrame::fitstrtowin(string in, int x) const
 
     return in.substr(0, len - 1);
 }
+
 void CursesFrame::refresh()
 {
-    if (w_border != NULL) {
+    redrawnborder = w_border != NULL &&
+                    (borderdirty || header != drawnheader || footer != drawnfooter ||
+                     focused != drawnfocused);
+
+    if (redrawnborder) {
+        /* the border window lies beneath the main one, which has to be
+           copied over it again */
+        touchwin(w_border);
+        touchwin(w_main);
+
         box(w_border, ACS_VLINE, ACS_HLINE);
 
         int headercol = focused ? C_INV : C_DEF;
         wattron(w_border, A_BOLD | headercol);
-        mvwprintw(w_border, 0, 1, header.c_str());
+        mvwprintw(w_border, 0, 1, "%s", header.c_str());
         wattroff(w_border, A_BOLD | headercol);
 
-        mvwprintw(w_border, w_border->_maxy, 1, footer.c_str());
+        mvwprintw(w_border, w_border->_maxy, 1, "%s", footer.c_str());
 
         wnoutrefresh(w_border);
+
+        drawnheader = header;
+        drawnfooter = footer;
+        drawnfocused = focused;
     }
     wnoutrefresh(w_main);
+
+    dirty = false;
+    borderdirty = false;
 }
 
-void CursesFrame::printw(string str, int attr)
+void CursesFrame::printw(string_ref str, int attr)
 {
     if (attr != 0) {
         wattron(w_main, attr);
     }
-    wprintw(w_main, fitstrtowin(str).c_str());
+    str = fitstrtowin(str);
+    waddnstr(w_main, str.data(), str.length());
     if (attr != 0) {
         wattroff(w_main, attr);
     }
 }
 
-void CursesFrame::mvprintw(int x, int y, string str, int attr)
+void CursesFrame::mvprintw(int x, int y, string_ref str, int attr)
 {
     if (attr != 0) {
         wattron(w_main, attr);
     }
-    mvwprintw(w_main, y, x, fitstrtowin(str, x).c_str());
+    str = fitstrtowin(str, x);
+    mvwaddnstr(w_main, y, x, str.data(), str.length());
     if (attr != 0) {
         wattroff(w_main, attr);
     }
 }
 
-string CursesFrame::escapestring(string str) const
+void CursesFrame::putlines(const std::vector<std::vector<chtype> > &lines)
+{
+    for (int y = 0; y < (int)lines.size() && y <= w_main->_maxy; y++) {
+        if (!lines[y].empty()) {
+            mvwaddchnstr(w_main, y, 0, lines[y].data(), lines[y].size());
+        }
+    }
+}
+
+void CursesFrame::newline()
 {
-    string ret = string(str);
-    size_t pos = 0;
-    while ((pos = ret.find("%", pos)) != string::npos) {
-        ret.replace(pos, 1, "%%");
-        pos++;
-        pos++;
+    /* the cursor only sits at the line start after output if that
+       output has filled the previous line completely */
+    if (getcurx(w_main) != 0) {
+        waddch(w_main, '\n');
     }
-    return ret;
 }
 
 void CursesFrame::clear()
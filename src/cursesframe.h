@@ -18,8 +18,10 @@
 #ifndef CURSESFRAME_H
 #define CURSESFRAME_H
 
+#include <boost/utility/string_ref.hpp>
 #include <ncurses.h>
 #include <string>
+#include <vector>
 
 #define C_DEF (COLOR_PAIR(5))
 #define C_DEF_HL1 (COLOR_PAIR(2))
@@ -44,8 +46,15 @@ public:
     void setheader(std::string str);
     void setfooter(std::string str);
     virtual void refresh();
-    void printw(std::string str, int attr = 0);
-    void mvprintw(int x, int y, std::string str, int attr = 0);
+    void printw(boost::string_ref str, int attr = 0);
+    void mvprintw(int x, int y, boost::string_ref str, int attr = 0);
+
+    /* Copies prepared lines of cells to the top of the frame. */
+    void putlines(const std::vector<std::vector<chtype> > &lines);
+
+    /* Starts a new line, unless the previous output has just wrapped
+       at the right border. */
+    void newline();
     void move(int x, int y);
     void clear();
     void setfocused(bool b)
@@ -53,13 +62,28 @@ public:
         focused = b;
     }
 
+    /* Makes the next refresh repaint the whole frame, for example after
+       it has been covered by another one. */
+    void invalidate();
+    bool isdirty() const
+    {
+        return dirty;
+    }
+
+    /* Borders of neighbouring frames overlap. If one of them has been drawn
+       again during the last refresh, the other one needs to follow. */
+    bool borderredrawn() const
+    {
+        return redrawnborder;
+    }
+    void invalidateborder();
+
     int usableheight() const;
     int usablewidth() const;
 
 protected:
 
-    std::string fitstrtowin(std::string in, int x = -1) const;
-    std::string escapestring(std::string str) const;
+    boost::string_ref fitstrtowin(boost::string_ref in, int x = -1) const;
 
     const std::string overflowind;
 
@@ -70,6 +94,15 @@ protected:
 
     bool focused;
 
+    /* set until the next refresh after invalidate(). the border is only
+       drawn again if it has changed since the last refresh */
+    bool dirty,
+         borderdirty,
+         redrawnborder;
+    std::string drawnheader,
+        drawnfooter;
+    bool drawnfocused;
+
     FrameInfo *finfo;
 };
 
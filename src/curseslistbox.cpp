@@ -113,6 +113,10 @@ void CursesListBox::updatefocus()
         }
 
         cursorpos = lsize - windowpos - 1;
+    } else if (focusedindex() < 0 && lsize > 0) {
+        /* the list was empty before */
+        windowpos = 0;
+        cursorpos = 0;
     }
 }
 
@@ -160,25 +164,46 @@ Package *CursesListBox::focusedpackage() const
     return list->at(focusedindex());
 }
 
-void CursesListBox::refresh()
+Package *CursesListBox::packageat(int index) const
 {
-    Package *pkg;
+    if (list == NULL || index < 0 || index >= (int)list->size()) {
+        return NULL;
+    }
+
+    return list->at(index);
+}
 
+void CursesListBox::refresh()
+{
     setheader(boost::str(boost::format("(%d)") % list->size()));
 
+    if (dirty) {
+        drawnrows.clear();
+    }
+    drawnrows.resize(usableheight() + 1);
+
+    /* only rows showing something else than last time are painted, so
+       moving the cursor touches two of them */
     for (int i = 0; i <= usableheight(); i++) {
-        if (windowpos + i > (int)list->size() - 1) {
-            break;
+        Row row = { NULL, 0 };
+        if (windowpos + i < (int)list->size()) {
+            row.pkg = list->at(windowpos + i);
+            row.attr = getcol(row.pkg->getcolindex());
+            if (i == cursorpos) {
+                row.attr |= A_REVERSE;
+            }
         }
 
-        pkg = list->at(windowpos + i);
-
-        int attr = getcol(pkg->getcolindex());
-        if (i == cursorpos) {
-            attr |= A_REVERSE;
+        if (!dirty && row.pkg == drawnrows[i].pkg && row.attr == drawnrows[i].attr) {
+            continue;
         }
 
-        mvprintw(0, i, pkg->getname().substr(0, usablewidth() + 1), attr);
+        wmove(w_main, i, 0);
+        wclrtoeol(w_main);
+        if (row.pkg != NULL) {
+            mvprintw(0, i, row.pkg->getstrattr(A_NAME).substr(0, usablewidth() + 1), row.attr);
+        }
+        drawnrows[i] = row;
     }
 
     CursesFrame::refresh();
@@ -39,18 +39,30 @@ public:
     void moveabs(int pos);
     int focusedindex() const;
     Package *focusedpackage() const;
+
+    /* Returns the package at the given list index, or NULL. */
+    Package *packageat(int index) const;
     void removeselected();
+
+    /* Moves the cursor back onto the list after it has shrunk. */
+    void updatefocus();
     virtual void refresh();
 
 protected:
 
     bool isinbounds(int pos) const;
-    void updatefocus();
     chtype getcol(int index) const;
 
     std::vector<Package *> *list;
     int windowpos,
         cursorpos;
+
+    /* what each row showed on the last refresh */
+    struct Row {
+        const Package *pkg;
+        chtype attr;
+    };
+    std::vector<Row> drawnrows;
 };
 
 #endif // CURSESLISTBOX_H
@@ -17,6 +17,7 @@
 
 #include "cursesui.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <ncurses.h>
 #include <signal.h>
@@ -25,22 +26,29 @@
 
 #include "cursesframe.h"
 #include "curseslistbox.h"
+#include "eventloop.h"
 #include "frameinfo.h"
 #include "globals.h"
 #include "package.h"
 #include "pcursesexception.h"
+#include "profiler.h"
 #include "state.h"
 
+using std::string;
 using std::vector;
 
 /* Static instance. */
 CursesUi CursesUi::instance;
 
+/* number of packages ahead of the focused one laid out in idle time */
+static const int PREFETCHED = 4;
+
 /* Resize signal handler. */
 static volatile bool want_resize = false;
 static void request_resize(int /* unused */)
 {
     want_resize = true;
+    EventLoop::wakeup();
 }
 
 CursesUi &CursesUi::ui()
@@ -101,10 +109,15 @@ void CursesUi::resize()
 
     CursesUi::ui().list_pane->reposition(w.ws_col, w.ws_row);
     CursesUi::ui().info_pane->reposition(w.ws_col, w.ws_row);
+    CursesUi::ui().output_pane->reposition(w.ws_col, w.ws_row);
     CursesUi::ui().queue_pane->reposition(w.ws_col, w.ws_row);
     CursesUi::ui().status_pane->reposition(w.ws_col, w.ws_row);
     CursesUi::ui().input_pane->reposition(w.ws_col, w.ws_row);
     CursesUi::ui().help_pane->reposition(w.ws_col, w.ws_row);
+
+    /* the layouts are made for the old pane size */
+    repaint = true;
+    infocache.clear();
 }
 
 void CursesUi::handle_resize(const State &state)
@@ -134,12 +147,9 @@ void CursesUi::enable_curses(vector<Package *> *pkgs, vector<Package *> *queue)
     curs_set(0);
     noecho();
 
-    /* getch() is our loop speed limiter. we use the nonblocking version
-      to handle window resizes without waiting for the next key event, but
-      use a timeout of 50 ms to limit the cpu usage to acceptable levels.
-      50 ms is just an initial value and is subject to change depending on how
-      well it works */
-    timeout(50);
+    /* getch() does not block, the main loop sleeps in EventLoop::wait()
+       until there is input, a resize or news from a background job */
+    timeout(0);
 
     /* target ist archlinux so we know a proper ncurses will be used.
        otherwise we would need to conditionally include this using
@@ -160,6 +170,7 @@ void CursesUi::enable_curses(vector<Package *> *pkgs, vector<Package *> *queue)
 
     list_pane = new CursesListBox(new FrameInfo(FE_LIST, COLS, LINES));
     info_pane = new CursesFrame(new FrameInfo(FE_INFO, COLS, LINES));
+    output_pane = new CursesFrame(new FrameInfo(FE_OUTPUT, COLS, LINES));
     queue_pane = new CursesListBox(new FrameInfo(FE_QUEUE, COLS, LINES));
     status_pane = new CursesFrame(new FrameInfo(FE_STATUS, COLS, LINES));
     input_pane = new CursesFrame(new FrameInfo(FE_INPUT, COLS, LINES));
@@ -167,11 +178,28 @@ void CursesUi::enable_curses(vector<Package *> *pkgs, vector<Package *> *queue)
 
     list_pane->setbackground(C_DEF);
     info_pane->setbackground(C_DEF);
+    output_pane->setbackground(C_DEF);
     queue_pane->setbackground(C_DEF);
     status_pane->setbackground(C_INV);
     input_pane->setbackground(C_DEF);
     help_pane->setbackground(C_DEF);
 
+    /* the new frames are painted from scratch */
+    repaint = true;
+    drawnmode = MODE_STANDARD;
+    drawnshowoutput = false;
+    drawnoutputversion = 0;
+    drawnoutputbegin = 0;
+    drawninfo = NULL;
+    drawnpartial = false;
+    waitforfields = true;
+    drawnindex = 0;
+    scrollstep = 1;
+    prefetchnext = PREFETCHED + 1;
+    infocache.clear();
+    drawnstatus.clear();
+    drawninput.clear();
+
     set_focus(PANE_LIST);
     list_pane->setlist(pkgs);
     queue_pane->setlist(queue);
@@ -182,6 +210,7 @@ void CursesUi::disable_curses()
     delete list_pane;
     delete queue_pane;
     delete info_pane;
+    delete output_pane;
     delete status_pane;
     delete input_pane;
     delete help_pane;
@@ -197,91 +226,232 @@ void CursesUi::disable_curses()
     }
 }
 
-void CursesUi::printinfosection(AttributeEnum attr, string text)
+void CursesUi::suspend()
 {
-    string caption = AttributeInfo::attrname(attr);
-    char hllower = AttributeInfo::attrtochar(attr);
-    char hlupper = toupper(hllower);
-    bool hldone = false;
-    int style;
-
-    for (uint i = 0; i < caption.size(); i++) {
-        if (!hldone && (caption[i] == hllower || caption[i] == hlupper)) {
-            style = C_DEF;
-            hldone = true;
-        } else {
-            style = C_DEF_HL2;
-        }
+    curs_set(1);
+    def_prog_mode();
+    endwin();
+
+    /* the command starts on an empty screen, like after disable_curses(),
+       but without running clear */
+    const char *cl = tigetstr(const_cast<char *>("clear"));
+    if (cl != NULL && cl != (char *)-1) {
+        putp(cl);
+        fflush(stdout);
+    }
+}
+
+void CursesUi::resume()
+{
+    reset_prog_mode();
+    curs_set(0);
+
+    /* the screen holds whatever the command has printed, and the terminal
+       may have been resized meanwhile */
+    clearok(curscr, TRUE);
+    repaint = true;
+    want_resize = true;
+}
 
+void CursesUi::print_output(const State &state)
+{
+    const size_t rows = output_pane->usableheight() + 1;
+    const size_t lines = state.output.size();
+
+    /* the end of the output is shown unless scrolled back */
+    const size_t maxscroll = (lines > rows) ? lines - rows : 0;
+    const size_t end = lines - std::min<size_t>(state.outputscroll, maxscroll);
+    const size_t begin = (end > rows) ? end - rows : 0;
+
+    /* the bottom border is covered by the status bar */
+    output_pane->setheader("(" + state.outputstatus + "): " + state.outputcmd);
+
+    if (!output_pane->isdirty() && state.outputversion == drawnoutputversion &&
+        begin == drawnoutputbegin) {
+        return;
+    }
+
+    output_pane->clear();
+    for (size_t i = begin; i < end; i++) {
+        output_pane->mvprintw(0, i - begin,
+                              boost::string_ref(state.output[i]).substr(0, output_pane->usablewidth() + 1));
+    }
+    drawnoutputversion = state.outputversion;
+    drawnoutputbegin = begin;
+}
+
+void CursesUi::invalidate()
+{
+    repaint = true;
+    infocache.clear();
+}
+
+bool CursesUi::prefetch_info()
+{
+    if (prefetchnext > PREFETCHED) {
+        return false;
+    }
 
-        info_pane->printw(string(1, caption[i]), style);
+    const Package *pkg = focused_pane->packageat(drawnindex + prefetchnext * scrollstep);
+    if (pkg == NULL) {
+        prefetchnext = PREFETCHED + 1;
+        return false;
     }
-    info_pane->printw(": ", C_DEF_HL2);
+    prefetchnext++;
 
-    string txt = text + "\n";
-    info_pane->printw(txt);
+    bool complete;
+    infocache.get(pkg, info_pane->usablewidth() + 1, info_pane->usableheight() + 1,
+                  waitforfields, complete);
+    return prefetchnext <= PREFETCHED;
 }
 
 void CursesUi::update_display(const State &state)
 {
+    Profiler::Span span("display");
+
     if (want_resize) {
         resize();
     }
 
+    /* the loader holds the alpm lock while it reads a db */
+    waitforfields = state.progress.empty();
+
     /* this runs **at least** once per loop iteration
        for example it can run more than once if we need to display
-       a 'processing' message during filtering
-     */
+       a 'processing' message during filtering.
+       only what has changed since the last run is painted again. */
+
+    /* the help and input panes cover the others */
+    if (state.mode != drawnmode || state.showoutput != drawnshowoutput) {
+        repaint = true;
+        drawnmode = state.mode;
+        drawnshowoutput = state.showoutput;
+    }
+
+    if (repaint) {
+        erase();
+        wnoutrefresh(stdscr);
+        list_pane->invalidate();
+        queue_pane->invalidate();
+        info_pane->invalidate();
+        output_pane->invalidate();
+        status_pane->invalidate();
+        input_pane->invalidate();
+        help_pane->invalidate();
+        repaint = false;
+    }
 
     if (state.mode == MODE_INPUT || state.mode == MODE_STANDARD) {
-        Package *pkg;
+        /* each frame's right border is overlapped by its right neighbour */
+        list_pane->refresh();
+        if (list_pane->borderredrawn()) {
+            queue_pane->invalidateborder();
+        }
+        queue_pane->refresh();
 
-        erase();
-        list_pane->clear();
-        info_pane->clear();
-        status_pane->clear();
-        input_pane->clear();
-        queue_pane->clear();
-
-        /* info pane */
-        pkg = focused_pane->focusedpackage();
-        if (pkg) {
-            for (int i = 0; i < A_NONE; i++) {
-                AttributeEnum attr = (AttributeEnum)i;
-                string txt = pkg->getattr(attr);
-                if (txt.length() != 0) {
-                    printinfosection(attr, txt);
+        /* the output of background commands takes the place of the info pane */
+        CursesFrame *side_pane = state.showoutput ? output_pane : info_pane;
+        if (queue_pane->borderredrawn()) {
+            side_pane->invalidateborder();
+        }
+
+        if (state.showoutput) {
+            print_output(state);
+        } else {
+            /* info pane */
+            const Package *pkg = focused_pane->focusedpackage();
+            if (info_pane->isdirty() || pkg != drawninfo || drawnpartial) {
+                bool complete = true;
+                info_pane->clear();
+                if (pkg) {
+                    info_pane->putlines(infocache.get(pkg, info_pane->usablewidth() + 1,
+                                                      info_pane->usableheight() + 1,
+                                                      waitforfields, complete));
                 }
+                drawninfo = pkg;
+                drawnpartial = !complete;
             }
         }
+        side_pane->refresh();
+
+        /* the bottom borders run beneath the status bar and the input line */
+        if (list_pane->borderredrawn() || queue_pane->borderredrawn() ||
+            side_pane->borderredrawn()) {
+            status_pane->invalidate();
+            input_pane->invalidate();
+        }
 
         /* status bar */
-        status_pane->mvprintw(1, 0, "Sorted by: ", C_INV_HL1);
-        status_pane->printw(AttributeInfo::attrname(state.sortedby), C_INV);
-        status_pane->printw(" Colored by: ", C_INV_HL1);
-        status_pane->printw(AttributeInfo::attrname(state.coloredby), C_INV);
-        status_pane->printw(" Filtered by: ", C_INV_HL1);
-        status_pane->printw(((state.searchphrases.length() == 0)
-                             ? "-" : state.searchphrases), C_INV);
+        vector<std::pair<string, int> > status;
+        status.push_back(std::make_pair("Sorted by: ", C_INV_HL1));
+        for (uint i = 0; i < state.sortedby.size(); i++) {
+            status.push_back(std::make_pair(string((i == 0) ? "" : ", ") +
+                                            ((state.sortedby[i].descending) ? "-" : "") +
+                                            AttributeInfo::attrname(state.sortedby[i].attr), C_INV));
+        }
+        status.push_back(std::make_pair(" Colored by: ", C_INV_HL1));
+        status.push_back(std::make_pair(AttributeInfo::attrname(state.coloredby), C_INV));
+        status.push_back(std::make_pair(" Filtered by: ", C_INV_HL1));
+        status.push_back(std::make_pair((state.searchphrases.length() == 0)
+                                        ? "-" : state.searchphrases, C_INV));
+        if (!state.search.empty()) {
+            status.push_back(std::make_pair(" Search: ", C_INV_HL1));
+            status.push_back(std::make_pair(state.search, C_INV));
+        }
+        if (!state.progress.empty()) {
+            status.push_back(std::make_pair(" Loading: ", C_INV_HL1));
+            status.push_back(std::make_pair(state.progress, C_INV));
+        }
+        if (!state.latency.empty()) {
+            status.push_back(std::make_pair(" Latency: ", C_INV_HL1));
+            status.push_back(std::make_pair(state.latency, C_INV));
+        }
+        if (!state.message.empty()) {
+            status.push_back(std::make_pair(" | ", C_INV_HL1));
+            status.push_back(std::make_pair(state.message, C_INV));
+        }
 
-        wnoutrefresh(stdscr);
-        list_pane->refresh();
-        queue_pane->refresh();
-        info_pane->refresh();
+        if (status_pane->isdirty() || status != drawnstatus) {
+            status_pane->clear();
+            status_pane->move(1, 0);
+            for (const auto &segment : status) {
+                status_pane->printw(segment.first, segment.second);
+            }
+            drawnstatus.swap(status);
+        }
         status_pane->refresh();
 
         if (state.mode == MODE_INPUT) {
-            input_pane->printw(optostr(state.op) + state.inputbuf.getcontents());
+            const string input = optostr(state.op) + state.inputbuf.getcontents();
+            if (input_pane->isdirty() || input != drawninput) {
+                input_pane->clear();
+                input_pane->printw(input);
+                drawninput = input;
+            }
             input_pane->move(state.inputbuf.getpos() + 1, 0);
             input_pane->refresh();
         }
     } else if (state.mode == MODE_HELP) {
-        help_pane->clear();
-        print_help();
+        if (help_pane->isdirty()) {
+            help_pane->clear();
+            print_help();
+        }
         help_pane->refresh();
     }
 
     doupdate();
+
+    /* the neighbours are laid out once the main loop is idle */
+    if (state.mode == MODE_STANDARD) {
+        const int index = focused_pane->focusedindex();
+        if (index != drawnindex) {
+            scrollstep = (index < drawnindex) ? -1 : 1;
+            drawnindex = index;
+        }
+        prefetchnext = 1;
+    } else {
+        prefetchnext = PREFETCHED + 1;
+    }
 }
 
 #define PRINTH(a, b) help_pane->printw(a, A_BOLD); help_pane->printw(b);
@@ -291,15 +461,20 @@ void CursesUi::print_help()
     PRINTH("q: ", "quit\n");
     PRINTH("1 to 0: ", "hotkeys (as configured in " APPLICATION_NAME ".conf)\n");
     PRINTH("!: ", "execute command, replacing %p with selected package names\n");
+    PRINTH("&: ", "execute command in the background, showing its output\n");
+    PRINTH("o: ", "switch between package info and command output\n");
+    PRINTH("J/K: ", "scroll command output\n");
     PRINTH("@: ", "run the specified macro (as configured in " APPLICATION_NAME ".conf)\n");
     PRINTH("%: ", "run the specified control command (for example, %filter_clear)\n");
-    PRINTH("r: ", "reload package info\n");
+    PRINTH("r: ", "reload changed package dbs\n");
     PRINTH("/: ", "filter packages by specified fields (using regexp)\n");
     PRINTH("", "   note that filters can be chained.\n")
     PRINTH("n: ", "filter packages by name (using regexp)\n");
     PRINTH("c: ", "clear all package filters\n");
+    PRINTH("u: ", "remove the last package filter\n");
     PRINTH("C: ", "clear the package queue\n");
     PRINTH("?: ", "search packages\n");
+    PRINTH(">/<: ", "move to the next/previous match of the last search\n");
     PRINTH(".: ", "sort packages by specified field\n");
     PRINTH(";: ", "colorcode packages by specified field\n");
     PRINTH("tab: ", "switch focus between list and queue panes\n");
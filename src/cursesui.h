@@ -21,6 +21,8 @@
 #include <vector>
 
 #include "attributeinfo.h"
+#include "infocache.h"
+#include "state.h"
 
 enum PaneEnum {
     PANE_LIST,
@@ -30,7 +32,6 @@ enum PaneEnum {
 class CursesListBox;
 class CursesFrame;
 class Package;
-class State;
 
 class CursesUi
 {
@@ -43,15 +44,30 @@ public:
     /* Disable ncurses handling of the console. */
     void disable_curses();
 
+    /* Hands the terminal over to a command and takes it back, keeping
+       all windows. */
+    void suspend();
+    void resume();
+
     /* Switches focus (if possible). */
     void switch_focus();
 
     /* Sets focus to the specified pane (if possible). */
     void set_focus(enum PaneEnum pane);
 
-    /* Paints the screen, called at least once every mainloop iteration. */
+    /* Paints what has changed on the screen, called at least once every
+       mainloop iteration. */
     void update_display(const State &state);
 
+    /* Makes the next update paint everything, needed if package data has
+       changed in place. */
+    void invalidate();
+
+    /* Lays out the next of the packages following the focused one in the
+       direction the cursor moved last, before they are asked for. Meant
+       for idle time, returns false once there is nothing left to do. */
+    bool prefetch_info();
+
     /* If a resize has been requested, reposition all windows and update the display. */
     void handle_resize(const State &state);
 
@@ -67,6 +83,10 @@ public:
     {
         return focused_pane;
     }
+    inline CursesFrame *output()
+    {
+        return output_pane;
+    }
 
 private:
     /* Prevent class construction and copying. */
@@ -77,7 +97,7 @@ private:
     void resize();
 
     void print_help();
-    void printinfosection(AttributeEnum attr, std::string text);
+    void print_output(const State &state);
 
     /* Throws exception if terminal size is below a fixed limit. */
     void ensure_min_term_size(uint w, uint h) const;
@@ -90,9 +110,29 @@ private:
                   *focused_pane;
 
     CursesFrame *info_pane,
+                *output_pane,
                 *input_pane,
                 *help_pane,
                 *status_pane;
+
+    /* what was shown by the last update */
+    bool repaint;
+    ModeEnum drawnmode;
+    bool drawnshowoutput;
+    uint drawnoutputversion;
+    size_t drawnoutputbegin;
+    const Package *drawninfo;
+    /* the info pane left out fields the loader kept locked */
+    bool drawnpartial;
+    /* lazy fields are only waited for once loading has finished */
+    bool waitforfields;
+    int drawnindex,
+        scrollstep,
+        prefetchnext;
+    std::vector<std::pair<std::string, int> > drawnstatus;
+    std::string drawninput;
+
+    InfoCache infocache;
 };
 
 #endif // CURSESUI_H
@@ -0,0 +1,181 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "dbwatcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "eventloop.h"
+#include "pcursesexception.h"
+#include "profiler.h"
+
+#define PIPE_READ 0
+#define PIPE_WRITE 1
+
+using std::string;
+
+/* how long the dbs have to stay untouched before they are looked at. pacman
+   writes many files in quick succession. */
+static const int SETTLE_MS = 500;
+
+DbWatcher::DbWatcher()
+    : inotifyfd(-1), ready(false)
+{
+    stopfds[PIPE_READ] = stopfds[PIPE_WRITE] = -1;
+}
+
+DbWatcher::~DbWatcher()
+{
+    stop();
+}
+
+void DbWatcher::start(const Config &conf)
+{
+    stop();
+
+    this->conf = conf;
+    const string dbpath = conf.getdbpath();
+
+    inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyfd == -1) {
+        throw PcursesException("failed to initialize inotify");
+    }
+
+    /* the lock file comes and goes with each transaction (which is all
+       that touches the desc file of a package when its install reason
+       changes), sync dbs are replaced by renaming downloads and local
+       entries are created and removed as a whole */
+    const struct {
+        string path;
+        uint32_t mask;
+    } watches[] = {
+        { dbpath, IN_CREATE | IN_DELETE },
+        { dbpath + "/sync", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE },
+        { dbpath + "/local", IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM }
+    };
+    for (const auto &w : watches) {
+        if (inotify_add_watch(inotifyfd, w.path.c_str(), w.mask | IN_ONLYDIR) == -1) {
+            close(inotifyfd);
+            inotifyfd = -1;
+            throw PcursesException("failed to watch " + w.path);
+        }
+    }
+
+    if (pipe2(stopfds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        close(inotifyfd);
+        inotifyfd = -1;
+        throw PcursesException("failed to create stop pipe");
+    }
+
+    worker = std::thread(&DbWatcher::work, this);
+}
+
+void DbWatcher::stop()
+{
+    if (!worker.joinable()) {
+        return;
+    }
+
+    const char c = 0;
+    if (write(stopfds[PIPE_WRITE], &c, 1) == -1) {
+        /* the pipe is full, so the worker is stopping anyway */
+    }
+    worker.join();
+
+    close(inotifyfd);
+    close(stopfds[PIPE_READ]);
+    close(stopfds[PIPE_WRITE]);
+    inotifyfd = stopfds[PIPE_READ] = stopfds[PIPE_WRITE] = -1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stamps.clear();
+    ready = false;
+}
+
+bool DbWatcher::poll(Snapshot::Stamps &stamps)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!ready) {
+        return false;
+    }
+
+    stamps.swap(this->stamps);
+    this->stamps.clear();
+    ready = false;
+    return true;
+}
+
+void DbWatcher::work()
+{
+    const string lockfile = conf.getdbpath() + "/db.lck";
+    bool dirty = false;
+
+    while (true) {
+        struct pollfd pfds[2] = {
+            { inotifyfd, POLLIN, 0 },
+            { stopfds[PIPE_READ], POLLIN, 0 }
+        };
+
+        /* without pending changes, sleep until the next event */
+        const int ret = ::poll(pfds, 2, dirty ? SETTLE_MS : -1);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        if (pfds[1].revents != 0) {
+            return;
+        }
+
+        if (ret > 0) {
+            /* the events themselves don't matter, the stamps tell what
+               has changed. this includes overflows of the event queue. */
+            char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            while (read(inotifyfd, buf, sizeof(buf)) > 0) { }
+            dirty = true;
+            continue;
+        }
+
+        /* a transaction is still running. removing the lock at its end
+           is an event of its own, there is nothing to do until then. */
+        if (access(lockfile.c_str(), F_OK) == 0) {
+            dirty = false;
+            continue;
+        }
+
+        Snapshot::Stamps current;
+        {
+            Profiler::Span span("watch dbs");
+            current = Snapshot::dbstamps(conf);
+        }
+        dirty = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stamps.swap(current);
+            ready = true;
+        }
+        EventLoop::wakeup();
+    }
+}
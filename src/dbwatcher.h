@@ -0,0 +1,66 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef DBWATCHER_H
+#define DBWATCHER_H
+
+#include <mutex>
+#include <thread>
+
+#include "config.h"
+#include "snapshot.h"
+
+/* Watches the sync dbs and the local db with inotify on a background thread.
+   Once changes have settled down (and pacman has released its lock), the
+   worker computes the db stamps and wakes up the event loop. It sleeps in
+   poll() otherwise, an idle session costs nothing. */
+class DbWatcher
+{
+public:
+    DbWatcher();
+    ~DbWatcher();
+
+    /* Starts watching the dbs of conf. Throws a PcursesException if they
+       can't be watched. */
+    void start(const Config &conf);
+
+    /* Stops the worker, does nothing if it isn't running. */
+    void stop();
+
+    /* If the dbs have changed since the last call, stores their stamps in
+       stamps and returns true. */
+    bool poll(Snapshot::Stamps &stamps);
+
+private:
+    DbWatcher(const DbWatcher &);
+    DbWatcher &operator=(const DbWatcher &);
+
+    void work();
+
+    std::thread worker;
+    std::mutex mutex;
+
+    /* only read by the worker while it runs */
+    Config conf;
+    int inotifyfd,
+        stopfds[2];
+
+    Snapshot::Stamps stamps;
+    bool ready;
+};
+
+#endif // DBWATCHER_H
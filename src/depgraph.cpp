@@ -0,0 +1,195 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "depgraph.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "package.h"
+#include "stringpool.h"
+
+using boost::string_ref;
+using std::vector;
+
+DepGraph::DepGraph()
+    : built(false)
+{
+}
+
+void DepGraph::clear()
+{
+    vector<uint32_t>().swap(depoffsets);
+    vector<uint32_t>().swap(deps);
+    vector<uint32_t>().swap(rdepoffsets);
+    vector<uint32_t>().swap(rdeps);
+    installed.clear();
+    asdeps.clear();
+    built = false;
+}
+
+string_ref DepGraph::depname(string_ref dep)
+{
+    return dep.substr(0, dep.find_first_of("<>="));
+}
+
+/* calls f for every space separated word of s */
+template <typename F>
+static void forwords(string_ref s, F f)
+{
+    while (!s.empty()) {
+        const size_t end = std::min(s.find(' '), s.size());
+        if (end != 0) {
+            f(s.substr(0, end));
+        }
+        s.remove_prefix(std::min(end + 1, s.size()));
+    }
+}
+
+/* packs (from, to) pairs sorted by from into adjacency arrays */
+static void pack(const vector<uint64_t> &pairs, uint32_t n,
+                 vector<uint32_t> &offsets, vector<uint32_t> &targets)
+{
+    offsets.assign(n + 1, 0);
+    targets.reserve(pairs.size());
+    for (uint64_t p : pairs) {
+        offsets[(p >> 32) + 1]++;
+        targets.push_back((uint32_t)p);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+}
+
+void DepGraph::build(const vector<Package *> &packages)
+{
+    const uint32_t n = packages.size();
+
+    clear();
+
+    installed.resize(n);
+    asdeps.resize(n);
+
+    std::unordered_map<string_ref, vector<uint32_t>, StringPool::Hash> providers;
+    for (uint32_t i = 0; i < n; i++) {
+        const int64_t reason = packages[i]->getnumattr(A_INSTALLSTATE);
+        installed[i] = reason != IRE_NOTINSTALLED;
+        asdeps[i] = reason == IRE_ASDEPS;
+
+        forwords(packages[i]->getstrattr(A_PROVIDES), [&] (string_ref p) {
+            providers[depname(p)].push_back(i);
+        });
+    }
+
+    /* (package, dependency) pairs */
+    vector<uint64_t> pairs;
+    vector<uint32_t> targets;
+    for (uint32_t i = 0; i < n; i++) {
+        forwords(packages[i]->getstrattr(A_DEPENDS), [&] (string_ref d) {
+            const string_ref name = depname(d);
+
+            targets.clear();
+            vector<Package *>::const_iterator it = std::lower_bound(packages.begin(),
+            packages.end(), name, [] (const Package *p, string_ref s) {
+                return p->getstrattr(A_NAME) < s;
+            });
+            if (it != packages.end() && (*it)->getstrattr(A_NAME) == name) {
+                targets.push_back(it - packages.begin());
+            } else {
+                const auto pit = providers.find(name);
+                if (pit == providers.end()) {
+                    return;
+                }
+                for (uint32_t p : pit->second) {
+                    if (installed[p]) {
+                        targets.push_back(p);
+                    }
+                }
+                if (targets.empty()) {
+                    targets = pit->second;
+                }
+            }
+
+            for (uint32_t t : targets) {
+                if (t != i) {
+                    pairs.push_back(((uint64_t)i << 32) | t);
+                }
+            }
+        });
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    pack(pairs, n, depoffsets, deps);
+
+    for (uint64_t &p : pairs) {
+        p = (p << 32) | (p >> 32);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pack(pairs, n, rdepoffsets, rdeps);
+
+    built = true;
+}
+
+void DepGraph::walk(const vector<uint32_t> &offsets, const vector<uint32_t> &targets,
+                    const vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask)
+{
+    boost::dynamic_bitset<> seen(mask.size());
+    vector<uint32_t> todo;
+
+    for (uint32_t s : seeds) {
+        if (!seen[s]) {
+            seen.set(s);
+            todo.push_back(s);
+        }
+    }
+
+    /* breadth first, todo doubles as the queue */
+    for (size_t head = 0; head < todo.size(); head++) {
+        const uint32_t u = todo[head];
+        for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++) {
+            const uint32_t t = targets[e];
+            mask.set(t);
+            if (!seen[t]) {
+                seen.set(t);
+                todo.push_back(t);
+            }
+        }
+    }
+}
+
+void DepGraph::dependencies(const vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask) const
+{
+    walk(depoffsets, deps, seeds, mask);
+}
+
+void DepGraph::dependents(const vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask) const
+{
+    walk(rdepoffsets, rdeps, seeds, mask);
+}
+
+void DepGraph::orphans(boost::dynamic_bitset<> &mask) const
+{
+    for (size_t i = asdeps.find_first(); i != boost::dynamic_bitset<>::npos;
+         i = asdeps.find_next(i)) {
+        bool needed = false;
+        for (uint32_t e = rdepoffsets[i]; e < rdepoffsets[i + 1] && !needed; e++) {
+            needed = installed[rdeps[e]];
+        }
+        mask[i] = !needed;
+    }
+}
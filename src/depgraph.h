@@ -0,0 +1,81 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef DEPGRAPH_H
+#define DEPGRAPH_H
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <vector>
+
+class Package;
+
+/* Dependency graph of all packages, stored as adjacency arrays in both
+   directions. Packages are identified by their position in the list passed
+   to build(), which must be sorted by name.
+
+   A dependency is resolved to the package of that name, or else to the
+   packages providing it. If some of the providers are installed, only those
+   are used. Version constraints are ignored. */
+class DepGraph
+{
+public:
+    DepGraph();
+
+    void build(const std::vector<Package *> &packages);
+    void clear();
+
+    bool isbuilt() const
+    {
+        return built;
+    }
+
+    /* Sets the bits of all packages which the seeds depend on, directly or
+       transitively. Seeds are only set if another seed depends on them.
+       mask must be sized like packages. */
+    void dependencies(const std::vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask) const;
+
+    /* Same as dependencies(), following the edges backwards: all packages
+       which depend on one of the seeds. */
+    void dependents(const std::vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask) const;
+
+    /* Sets the bits of all packages installed as dependencies which no
+       installed package depends on. */
+    void orphans(boost::dynamic_bitset<> &mask) const;
+
+private:
+    /* name of the package a dependency or provision refers to */
+    static boost::string_ref depname(boost::string_ref dep);
+
+    static void walk(const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &targets,
+                     const std::vector<uint32_t> &seeds, boost::dynamic_bitset<> &mask);
+
+    /* the dependencies of package i are deps[depoffsets[i]] to
+       deps[depoffsets[i + 1]], likewise for its dependents in rdeps */
+    std::vector<uint32_t> depoffsets,
+        deps,
+        rdepoffsets,
+        rdeps;
+
+    boost::dynamic_bitset<> installed,
+          asdeps;
+
+    bool built;
+};
+
+#endif // DEPGRAPH_H
@@ -0,0 +1,99 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "eventloop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "pcursesexception.h"
+
+#define PIPE_READ 0
+#define PIPE_WRITE 1
+
+int EventLoop::fds[2] = { -1, -1 };
+
+void EventLoop::init()
+{
+    if (fds[PIPE_READ] != -1) {
+        return;
+    }
+
+    /* neither side may block: a full pipe already holds a pending wakeup */
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+        throw PcursesException("failed to create wakeup pipe");
+    }
+}
+
+void EventLoop::deinit()
+{
+    if (fds[PIPE_READ] == -1) {
+        return;
+    }
+
+    close(fds[PIPE_READ]);
+    close(fds[PIPE_WRITE]);
+    fds[PIPE_READ] = fds[PIPE_WRITE] = -1;
+}
+
+bool EventLoop::wait(int fd)
+{
+    struct pollfd pfds[2] = {
+        { fd, POLLIN, 0 },
+        { fds[PIPE_READ], POLLIN, 0 }
+    };
+
+    /* interrupted by a signal, whose handler has sent a wakeup or has
+       nothing to tell us */
+    if (poll(pfds, 2, -1) == -1) {
+        if (errno == EINTR) {
+            return true;
+        }
+        throw PcursesException("poll() failed");
+    }
+
+    /* wakeups sent until now are handled by the caller */
+    char buf[64];
+    while (read(fds[PIPE_READ], buf, sizeof(buf)) > 0) { }
+
+    return (pfds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) == 0;
+}
+
+bool EventLoop::idle(int fd)
+{
+    struct pollfd pfds[2] = {
+        { fd, POLLIN, 0 },
+        { fds[PIPE_READ], POLLIN, 0 }
+    };
+
+    /* the wakeups are left for wait() */
+    return poll(pfds, 2, 0) == 0;
+}
+
+void EventLoop::wakeup()
+{
+    const int saved = errno;
+    const char c = 0;
+
+    if (write(fds[PIPE_WRITE], &c, 1) == -1) {
+        /* the pipe is full, so wait() is about to return anyway */
+    }
+
+    errno = saved;
+}
@@ -0,0 +1,48 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+/* Lets the main loop sleep until there is something to do: input on the
+   terminal, a signal or a background job which has made progress. Wakeups
+   go through a pipe, so they may be sent from other threads and from
+   signal handlers. */
+class EventLoop
+{
+public:
+    /* Sets up the wakeup pipe. Must be called before any wakeup is sent. */
+    static void init();
+
+    /* Closes the wakeup pipe, once no thread sends wakeups anymore. */
+    static void deinit();
+
+    /* Blocks until fd is readable or wakeup() has been called since the
+       last wait. Returns false if fd has been hung up. */
+    static bool wait(int fd);
+
+    /* Returns true if wait(fd) would block right now. */
+    static bool idle(int fd);
+
+    /* Makes the current or next wait() return. Async signal safe. */
+    static void wakeup();
+
+private:
+    static int fds[2];
+};
+
+#endif // EVENTLOOP_H
@@ -18,10 +18,6 @@
 #ifndef FILTER_H
 #define FILTER_H
 
-#include <boost/xpressive/xpressive.hpp>
-#include <map>
-#include <vector>
-
 #include "attributeinfo.h"
 
 class Package;
@@ -29,24 +25,7 @@ class Package;
 class Filter
 {
 public:
-    static void setattrs(std::string s);
-    static void clearattrs();
-
     static bool cmp(const Package *lhs, const Package *rhs, AttributeEnum attr);
-    static bool matchesre(const Package *a,
-                          const boost::xpressive::sregex needle);
-    static bool matches(const Package *a, const std::string needle);
-    static bool notmatchesre(const Package *a,
-                             const boost::xpressive::sregex needle);
-    static bool notmatches(const Package *a, const std::string needle);
-
-    static void assigncol(Package *a, AttributeEnum attr);
-
-private:
-
-    static std::vector<AttributeEnum> attrlist;
-
-    static std::map<std::string, int> groups;
 };
 
 #endif // FILTER_H
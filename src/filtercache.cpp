@@ -0,0 +1,109 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+#include "filtercache.h"
+
+using std::string;
+using std::vector;
+
+FilterCache::FilterCache()
+    : capacity(0), generation(0)
+{
+}
+
+void FilterCache::setcapacity(size_t capacity)
+{
+    this->capacity = capacity;
+
+    while (entries.size() > capacity) {
+        index.erase(entries.back().chain);
+        entries.pop_back();
+    }
+}
+
+void FilterCache::invalidate()
+{
+    generation++;
+
+    /* nothing of the old generation can be used anymore */
+    entries.clear();
+    index.clear();
+}
+
+FilterCache::Entry *FilterCache::touch(const string &chain)
+{
+    std::unordered_map<string, EntryList::iterator>::iterator it = index.find(chain);
+    if (it == index.end() || it->second->generation != generation) {
+        return NULL;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    return &entries.front();
+}
+
+const boost::dynamic_bitset<> *FilterCache::findmask(const string &chain)
+{
+    const Entry *e = touch(chain);
+    return (e == NULL) ? NULL : &e->mask;
+}
+
+void FilterCache::insertmask(const string &chain, const boost::dynamic_bitset<> &mask)
+{
+    if (capacity == 0) {
+        return;
+    }
+
+    /* a chain has the same result throughout a generation */
+    if (touch(chain) != NULL) {
+        return;
+    }
+
+    std::unordered_map<string, EntryList::iterator>::iterator it = index.find(chain);
+    if (it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    entries.push_front(Entry());
+    Entry &e = entries.front();
+    e.chain = chain;
+    e.generation = generation;
+    e.mask = mask;
+    e.hasview = false;
+    index[chain] = entries.begin();
+
+    setcapacity(capacity);
+}
+
+const vector<Package *> *FilterCache::findview(const string &chain,
+        const vector<SortKey> &order)
+{
+    const Entry *e = touch(chain);
+    return (e == NULL || !e->hasview || e->order != order) ? NULL : &e->view;
+}
+
+void FilterCache::insertview(const string &chain, const vector<SortKey> &order,
+                             const vector<Package *> &view)
+{
+    Entry *e = touch(chain);
+    if (e == NULL) {
+        return;
+    }
+
+    e->hasview = true;
+    e->order = order;
+    e->view = view;
+}
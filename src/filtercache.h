@@ -0,0 +1,84 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+#ifndef FILTERCACHE_H
+#define FILTERCACHE_H
+
+#include <boost/dynamic_bitset.hpp>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sortcache.h"
+
+class Package;
+
+/* Results of recently applied filter chains, so that chains which are applied
+   over and over (e.g. by hotkey macros) are not evaluated again. A chain is
+   identified by the normalized queries of all its filters, in order. Each
+   entry holds the resulting mask and, once it has been shown, the package
+   list view for one sort order. The least recently used entry is dropped
+   once there are more than capacity. */
+class FilterCache
+{
+public:
+    FilterCache();
+
+    /* 0 disables the cache */
+    void setcapacity(size_t capacity);
+
+    /* The package set has changed, starts a new generation. Results of
+       older generations are never returned. */
+    void invalidate();
+
+    /* NULL if chain is not cached. The pointer stays valid until
+       the cache is next changed. */
+    const boost::dynamic_bitset<> *findmask(const std::string &chain);
+    void insertmask(const std::string &chain, const boost::dynamic_bitset<> &mask);
+
+    /* the view of chain sorted by order, NULL if it has not been stored */
+    const std::vector<Package *> *findview(const std::string &chain,
+                                           const std::vector<SortKey> &order);
+    /* only kept for chains which are cached */
+    void insertview(const std::string &chain, const std::vector<SortKey> &order,
+                    const std::vector<Package *> &view);
+
+private:
+    struct Entry {
+        std::string chain;
+        uint64_t generation;
+        boost::dynamic_bitset<> mask;
+        bool hasview;
+        std::vector<SortKey> order;
+        std::vector<Package *> view;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    /* moves the entry of chain to the front, NULL if there is none */
+    Entry *touch(const std::string &chain);
+
+    size_t capacity;
+    uint64_t generation;
+
+    /* most recently used first */
+    EntryList entries;
+    std::unordered_map<std::string, EntryList::iterator> index;
+};
+
+#endif // FILTERCACHE_H
@@ -42,12 +42,13 @@ void FrameInfo::recalcinfo(uint termw, uint termh)
         title = "Packages";
         break;
     case FE_INFO:
+    case FE_OUTPUT:
         w = termw - leftpanewidth + 1;
         h = paneheight;
         x = leftpanewidth - 1;
         y = 0;
         hasborder = true;
-        title = "Info (press h for help)";
+        title = (type == FE_INFO) ? "Info (press h for help)" : "Output";
         break;
     case FE_QUEUE:
         w = leftpanewidth;
@@ -74,7 +75,7 @@ void FrameInfo::recalcinfo(uint termw, uint termh)
         break;
     case FE_HELP:
         w = termw - 10;
-        h = 21; /* number of help items */
+        h = termh - 2;
         x = (termw - w) / 2;
         y = 1;
         hasborder = true;
@@ -91,6 +92,7 @@ void FrameInfo::recalcinfo(uint termw, uint termh)
             h = paneheight;
             break;
         case FE_INFO:
+        case FE_OUTPUT:
             w = termw - leftpanewidth * 2 + 1;
             x = leftpanewidth * 2 - 2;
             break;
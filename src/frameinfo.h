@@ -24,6 +24,7 @@
 enum FrameEnum {
     FE_LIST,
     FE_INFO,
+    FE_OUTPUT,
     FE_QUEUE,
     FE_STATUS,
     FE_INPUT,
@@ -0,0 +1,187 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "infocache.h"
+
+#include <boost/utility/string_ref.hpp>
+#include <ctype.h>
+
+#include "attributeinfo.h"
+#include "cursesframe.h"
+#include "package.h"
+
+using boost::string_ref;
+
+namespace
+{
+
+/* Puts text into lines the way waddch() does in a window which does not
+   scroll: lines wrap at the right border and output stops at the bottom. */
+class LineWriter
+{
+public:
+    LineWriter(int w, int h, InfoCache::Layout &l)
+        : width(w), height(h), lines(l), wrapped(false) {
+        lines.assign(1, InfoCache::Line());
+    }
+
+    void print(string_ref str, chtype attr) {
+        for (char c : str) {
+            put(c, attr);
+        }
+    }
+
+    /* see CursesFrame::newline() */
+    void newline() {
+        if (!lines.back().empty()) {
+            breakline(false);
+        }
+    }
+
+private:
+    void put(char c, chtype attr) {
+        if (c == '\n') {
+            /* see CursesFrame::fitstrtowin() */
+            if (!wrapped) {
+                breakline(false);
+            }
+            wrapped = false;
+        } else if (c == '\t') {
+            do {
+                putcell(' ', attr);
+            } while (!lines.back().empty() && lines.back().size() % TABSIZE != 0);
+        } else if (iscntrl((unsigned char)c)) {
+            for (const char *s = unctrl((unsigned char)c); *s != '\0'; s++) {
+                putcell(*s, attr);
+            }
+        } else {
+            putcell(c, attr);
+        }
+    }
+
+    void putcell(char c, chtype attr) {
+        if (full()) {
+            return;
+        }
+        lines.back().push_back((unsigned char)c | attr);
+        wrapped = false;
+        if ((int)lines.back().size() == width) {
+            breakline(true);
+        }
+    }
+
+    void breakline(bool wrap) {
+        /* a line past the bottom marks the window as full */
+        if (!full()) {
+            lines.push_back(InfoCache::Line());
+            wrapped = wrap;
+        }
+    }
+
+    bool full() const {
+        return (int)lines.size() > height;
+    }
+
+    const int width,
+          height;
+    InfoCache::Layout &lines;
+    bool wrapped;
+};
+
+}
+
+InfoCache::InfoCache(size_t capacity)
+    : capacity(capacity)
+{
+}
+
+const InfoCache::Layout &InfoCache::get(const Package *pkg, int w, int h,
+                                        bool wait, bool &complete)
+{
+    const Key key(pkg, w, h);
+
+    complete = true;
+
+    std::map<Key, Entries::iterator>::iterator it = index.find(key);
+    if (it != index.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    if (!wait && !layout(pkg, w, h, false, partial)) {
+        complete = false;
+        return partial;
+    }
+
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+
+    entries.push_front(std::make_pair(key, Layout()));
+    index[key] = entries.begin();
+    layout(pkg, w, h, true, entries.front().second);
+
+    return entries.front().second;
+}
+
+void InfoCache::clear()
+{
+    entries.clear();
+    index.clear();
+}
+
+bool InfoCache::layout(const Package *pkg, int w, int h, bool wait, Layout &lines)
+{
+    LineWriter writer(w, h, lines);
+    bool complete = true;
+
+    for (int i = 0; i < A_NONE; i++) {
+        AttributeEnum attr = (AttributeEnum)i;
+        string_ref txt;
+        if (wait) {
+            txt = pkg->getstrattr(attr);
+        } else if (!pkg->trygetstrattr(attr, txt)) {
+            txt = "(loading)";
+            complete = false;
+        }
+        if (txt.length() == 0) {
+            continue;
+        }
+
+        /* the character selecting the attribute in queries stands out */
+        const std::string caption = AttributeInfo::attrname(attr);
+        const char hllower = AttributeInfo::attrtochar(attr);
+        const char hlupper = toupper(hllower);
+        size_t hl = caption.find_first_of(std::string {hllower, hlupper});
+
+        for (size_t j = 0; j < caption.size(); j++) {
+            writer.print(string_ref(&caption[j], 1), (j == hl) ? C_DEF : C_DEF_HL2);
+        }
+        writer.print(": ", C_DEF_HL2);
+
+        /* written cells do not pick up the window background */
+        writer.print(txt, C_DEF);
+        writer.newline();
+    }
+
+    while (lines.size() > (size_t)h || (!lines.empty() && lines.back().empty())) {
+        lines.pop_back();
+    }
+
+    return complete;
+}
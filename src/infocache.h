@@ -0,0 +1,66 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef INFOCACHE_H
+#define INFOCACHE_H
+
+#include <list>
+#include <map>
+#include <ncurses.h>
+#include <tuple>
+#include <vector>
+
+class Package;
+
+/* Keeps the info pane contents of recently shown packages, laid out for a
+   given pane size, so that they only need to be copied to the screen when
+   the cursor comes back to them. */
+class InfoCache
+{
+public:
+    typedef std::vector<chtype> Line;
+    typedef std::vector<Line> Layout;
+
+    InfoCache(size_t capacity = 256);
+
+    /* Returns the info pane contents of pkg for a pane of w by h cells,
+       laying them out on the first request. Unless wait is set, fields
+       which can't be computed right now are shown as being loaded, and
+       complete is cleared. Such layouts are not kept. */
+    const Layout &get(const Package *pkg, int w, int h, bool wait, bool &complete);
+
+    /* Forgets all layouts, needed when packages change in place. */
+    void clear();
+
+private:
+    typedef std::tuple<const Package *, int, int> Key;
+    typedef std::list<std::pair<Key, Layout> > Entries;
+
+    /* returns false if a field was left out */
+    static bool layout(const Package *pkg, int w, int h, bool wait, Layout &lines);
+
+    const size_t capacity;
+
+    /* most recently used first */
+    Entries entries;
+    std::map<Key, Entries::iterator> index;
+
+    /* the last incomplete layout */
+    Layout partial;
+};
+
+#endif // INFOCACHE_H
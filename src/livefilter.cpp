@@ -0,0 +1,161 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "livefilter.h"
+
+#include "eventloop.h"
+#include "profiler.h"
+#include "query.h"
+
+using std::string;
+using std::vector;
+
+LiveFilter::LiveFilter()
+    : generation(0), haspending(false), running(false), stopping(false),
+      lastquery(NULL), lastready(false)
+{
+    pending.query = NULL;
+    worker = std::thread(&LiveFilter::work, this);
+}
+
+LiveFilter::~LiveFilter()
+{
+    cancel();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+}
+
+void LiveFilter::submit(Query *query, const string &str,
+                        const vector<Package *> *packages,
+                        const boost::dynamic_bitset<> *base,
+                        const TrigramIndex *index, uint threads)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        /* stops the running job, if any */
+        generation++;
+
+        delete pending.query;
+        pending.query = query;
+        pending.str = str;
+        pending.packages = packages;
+        pending.index = index;
+        pending.threads = threads;
+        pending.generation = generation;
+        haspending = true;
+
+        if (lastquery != NULL && query->refines(*lastquery)) {
+            pendingbase = lastmask;
+        } else {
+            pendingbase = *base;
+        }
+    }
+
+    wakeup.notify_one();
+}
+
+bool LiveFilter::poll(string &str, boost::dynamic_bitset<> &mask)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!lastready) {
+        return false;
+    }
+
+    str = laststr;
+    mask = lastmask;
+    lastready = false;
+    return true;
+}
+
+void LiveFilter::cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    generation++;
+
+    delete pending.query;
+    pending.query = NULL;
+    haspending = false;
+
+    idle.wait(lock, [this] () {
+        return !running;
+    });
+
+    delete lastquery;
+    lastquery = NULL;
+    laststr.clear();
+    lastmask.clear();
+    lastready = false;
+}
+
+void LiveFilter::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wakeup.wait(lock, [this] () {
+            return stopping || haspending;
+        });
+
+        if (stopping) {
+            return;
+        }
+
+        Job job = pending;
+        boost::dynamic_bitset<> base;
+        base.swap(pendingbase);
+        pending.query = NULL;
+        haspending = false;
+        running = true;
+
+        lock.unlock();
+
+        boost::dynamic_bitset<> mask(job.packages->size());
+        bool finished;
+        {
+            Profiler::Span span("live filter");
+            finished = job.query->select(*job.packages, base, job.index, job.threads, mask,
+            [this, &job] () {
+                return generation != job.generation;
+            });
+        }
+
+        lock.lock();
+
+        running = false;
+
+        if (finished && generation == job.generation) {
+            delete lastquery;
+            lastquery = job.query;
+            laststr = job.str;
+            lastmask.swap(mask);
+            lastready = true;
+            EventLoop::wakeup();
+        } else {
+            delete job.query;
+        }
+
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,98 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef LIVEFILTER_H
+#define LIVEFILTER_H
+
+#include <atomic>
+#include <boost/dynamic_bitset.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Package;
+class Query;
+class TrigramIndex;
+
+/* Evaluates filter queries on a background thread while they are typed.
+   Submitting a query cancels the one being evaluated. If a query only
+   narrows down the last finished one, it is evaluated on that result
+   instead of on all packages. */
+class LiveFilter
+{
+public:
+    LiveFilter();
+    ~LiveFilter();
+
+    /* Starts evaluating query (which is taken over) on the packages selected
+       by base. packages, base and index (which may be NULL) must stay
+       unchanged until cancel() is called. */
+    void submit(Query *query, const std::string &str,
+                const std::vector<Package *> *packages,
+                const boost::dynamic_bitset<> *base,
+                const TrigramIndex *index, uint threads);
+
+    /* If a result has finished since the last call, stores it in str and
+       mask and returns true. */
+    bool poll(std::string &str, boost::dynamic_bitset<> &mask);
+
+    /* Stops the current evaluation, waits for the worker to become idle and
+       forgets all results. */
+    void cancel();
+
+private:
+    LiveFilter(const LiveFilter &);
+    LiveFilter &operator=(const LiveFilter &);
+
+    struct Job {
+        Query *query;
+        std::string str;
+        const std::vector<Package *> *packages;
+        const TrigramIndex *index;
+        uint threads;
+        uint64_t generation;
+    };
+
+    void work();
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeup,
+        idle;
+
+    /* bumped by every submit() and cancel(), stale jobs check it to stop early */
+    std::atomic<uint64_t> generation;
+
+    Job pending;
+    bool haspending,
+         running,
+         stopping;
+
+    /* the last finished job, its mask is the base for refining it */
+    Query *lastquery;
+    std::string laststr;
+    boost::dynamic_bitset<> lastmask;
+    bool lastready;
+
+    /* base passed with the pending job, or lastmask */
+    boost::dynamic_bitset<> pendingbase;
+};
+
+#endif // LIVEFILTER_H
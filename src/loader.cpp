@@ -0,0 +1,117 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "loader.h"
+
+#include "eventloop.h"
+
+using std::string;
+using std::vector;
+
+Loader::Loader()
+    : stop(false), finished(false)
+{
+}
+
+Loader::~Loader()
+{
+    cancel();
+}
+
+void Loader::start(const Job &job)
+{
+    cancel();
+
+    stop = false;
+    finished = false;
+    error = std::exception_ptr();
+    worker = std::thread(&Loader::work, this, job);
+}
+
+void Loader::cancel()
+{
+    stop = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    batches.clear();
+    progress.clear();
+    error = std::exception_ptr();
+}
+
+bool Loader::poll(vector<Batch> &out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Batch &batch : batches) {
+        out.push_back(Batch());
+        std::swap(out.back(), batch);
+    }
+    batches.clear();
+
+    if (error) {
+        std::exception_ptr e = error;
+        error = std::exception_ptr();
+        std::rethrow_exception(e);
+    }
+
+    return finished;
+}
+
+string Loader::getprogress()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return progress;
+}
+
+void Loader::publish(Batch &batch)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    batches.push_back(Batch());
+    std::swap(batches.back(), batch);
+    EventLoop::wakeup();
+}
+
+void Loader::setprogress(const string &str)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    progress = str;
+    EventLoop::wakeup();
+}
+
+bool Loader::cancelled() const
+{
+    return stop;
+}
+
+void Loader::work(Job job)
+{
+    std::exception_ptr e;
+
+    try {
+        job(*this);
+    } catch (...) {
+        e = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    error = e;
+    finished = true;
+    EventLoop::wakeup();
+}
@@ -0,0 +1,92 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Package;
+
+/* Runs the package loading job on a background thread. The job hands out
+   packages in batches as soon as they are ready, the main thread picks them
+   up using poll(). */
+class Loader
+{
+public:
+    struct Batch {
+        /* name of the db the packages come from */
+        std::string source;
+        std::vector<Package *> packages;
+        /* version sort keys of packages, if already known */
+        std::vector<int64_t> versionkeys;
+        /* installed versions by package name, one map per other root.
+           only set by the batch which has read them, it has no packages */
+        std::vector<std::unordered_map<std::string, std::string> > rootversions;
+    };
+
+    typedef std::function<void(Loader &)> Job;
+
+    Loader();
+    ~Loader();
+
+    /* Starts job on the background thread. Only one job may run at a time. */
+    void start(const Job &job);
+
+    /* Stops the job as soon as it checks for cancellation and waits for it.
+       Batches which have not been taken yet are dropped. */
+    void cancel();
+
+    /* Moves all batches published since the last call to batches. Returns
+       true once the job has finished and all of its batches have been
+       taken. If the job failed, its exception is rethrown instead. */
+    bool poll(std::vector<Batch> &batches);
+
+    /* A short description of what the job is currently doing. */
+    std::string getprogress();
+
+    /* Called by the job. */
+    void publish(Batch &batch);
+    void setprogress(const std::string &progress);
+    bool cancelled() const;
+
+private:
+    Loader(const Loader &);
+    Loader &operator=(const Loader &);
+
+    void work(Job job);
+
+    std::thread worker;
+    std::mutex mutex;
+
+    std::atomic<bool> stop;
+
+    std::vector<Batch> batches;
+    std::string progress;
+    std::exception_ptr error;
+    bool finished;
+};
+
+#endif // LOADER_H
@@ -17,23 +17,45 @@
 
 #include <iostream>
 #include <unistd.h>
+#include <vector>
 
 #include "globals.h"
 #include "pcursesexception.h"
+#include "profiler.h"
 #include "program.h"
 
 static char *opt_conf_file = nullptr;
+static char *opt_profile_file = nullptr;
+static bool opt_batch = false;
+static std::vector<std::string> opt_commands;
+static std::string opt_columns = "name,version";
+static bool opt_json = false;
+static std::vector<std::string> opt_roots;
 
 static void usage()
 {
     fprintf(stderr,
-            "Usage: %s [-h] [-v] [-f CONF_FILE]\n"
+            "Usage: %s [-h] [-v] [-f CONF_FILE] [-p PROFILE_FILE] [-r ROOT]...\n"
+            "       %s -b [-e COMMAND]... [-o COLUMNS] [-j] [-f CONF_FILE] [-p PROFILE_FILE]\n"
+            "          [-r ROOT]...\n"
             "\n"
             "Arguments:\n"
             "----------\n"
             "-h:            print this message\n"
             "-v:            print version info\n"
             "-f:            specify an alternate config file location\n"
+            "-p:            write timings and allocations of all operations to\n"
+            "               PROFILE_FILE on exit (tab separated)\n"
+            "-r:            compare the installed packages with those in ROOT (a chroot\n"
+            "               or container), repeatable\n"
+            "-b:            batch mode: run the -e commands without a ui and print\n"
+            "               the resulting package list to stdout\n"
+            "-e:            command to run in batch mode, as typed (for example\n"
+            "               '@clearfilter,filterupdates' or '/n:^lib'), repeatable\n"
+            "-o:            comma separated output columns in batch mode (default\n"
+            "               name,version), see the README for all column names\n"
+            "-j:            print one JSON object per package instead of tab\n"
+            "               separated values\n"
             "\n"
             "Detailed help can be found the README and CONCEPT files located at\n"
             "https://github.com/schuay/pcurses\n"
@@ -44,14 +66,19 @@ static void usage()
             "q:             quit\n"
             "1 to 0:        hotkeys (as configured in %s.conf)\n"
             "!:             execute command, replacing %%p with selected package names\n"
+            "&:             execute command in the background, showing its output\n"
+            "o:             switch between package info and command output\n"
+            "J/K:           scroll command output\n"
             "@:             run the specified macro (as configured in %s.conf)\n"
             "%%:             run the specified control command (for example, %%filter_clear)\n"
-            "r:             reload package info\n"
+            "r:             reload changed package dbs\n"
             "/:             filter packages by specified fields (using regexp)\n"
             "n:             filter packages by name (using regexp)\n"
             "c:             clear all package filters\n"
+            "u:             remove the last package filter\n"
             "C:             clear the package queue\n"
             "?:             search packages\n"
+            ">/<:           move to the next/previous match of the last search\n"
             ".:             sort packages by specified field\n"
             ";:             colorcode packages by specified field\n"
             "tab:           switch focus between list and queue panes\n"
@@ -84,19 +111,41 @@ static void usage()
             "The following strings may be used as control commands:\n"
             "\n"
             "scroll_up, scroll_down, scroll_home, scroll_end, scroll_pageup,scroll_pagedown,\n"
-            "switch_focus,queue_push,queue_pop,queue_clear,help,quit,reload,filter_clear\n",
-            APPLICATION_NAME, APPLICATION_NAME, APPLICATION_NAME);
+            "switch_focus,queue_push,queue_pop,queue_clear,queue_push_filtered,\n"
+            "queue_pop_filtered,queue_invert,help,quit,reload,reload_full,\n"
+            "filter_clear,filter_pop,filter_deps,filter_rdeps,filter_orphans,\n"
+            "filter_rootdiff,search_next,search_prev,\n"
+            "mem_stats,stats,output_toggle,output_up,output_down,exec_kill\n",
+            APPLICATION_NAME, APPLICATION_NAME, APPLICATION_NAME, APPLICATION_NAME);
 }
 
 static void parseargs(int argc, char *argv[])
 {
     int opt;
 
-    while ((opt = getopt(argc, argv, "hvf:")) != -1) {
+    while ((opt = getopt(argc, argv, "hvf:p:r:be:o:j")) != -1) {
         switch (opt) {
+        case 'b':
+            opt_batch = true;
+            break;
+        case 'e':
+            opt_commands.push_back(optarg);
+            break;
+        case 'o':
+            opt_columns = optarg;
+            break;
+        case 'j':
+            opt_json = true;
+            break;
         case 'f':
             opt_conf_file = optarg;
             break;
+        case 'p':
+            opt_profile_file = optarg;
+            break;
+        case 'r':
+            opt_roots.push_back(optarg);
+            break;
         case 'v':
             fprintf(stdout, "%s %d\n", APPLICATION_NAME, VERSION);
             exit(EXIT_SUCCESS);
@@ -107,19 +156,34 @@ static void parseargs(int argc, char *argv[])
             exit(EXIT_FAILURE);
         }
     }
+
+    /* the batch options mean nothing with a ui */
+    if (!opt_batch && (!opt_commands.empty() || opt_json)) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
 }
 
 int main(int argc, char *argv[])
 {
     std::string err;
+    bool failed = false;
 
     parseargs(argc, argv);
 
     Program *p = new Program();
+    p->setroots(opt_roots);
 
     try {
-        p->init(opt_conf_file);
-        p->mainloop();
+        if (opt_batch) {
+            /* reject unknown columns before loading all packages */
+            BatchOutput output(stdout, opt_columns, opt_json);
+            p->init(opt_conf_file, true);
+            failed = !p->runbatch(opt_commands, output);
+        } else {
+            p->init(opt_conf_file);
+            p->mainloop();
+        }
     } catch (PcursesException e) {
         err = e.getmessage();
     } catch (...) {
@@ -128,6 +192,10 @@ int main(int argc, char *argv[])
 
     delete p;
 
+    if (opt_profile_file != nullptr && !Profiler::write(opt_profile_file)) {
+        std::cerr << "profile could not be written to " << opt_profile_file << std::endl;
+    }
+
     /* printing any errors at this point, because the Program destructor
       clears the screen */
     if (!err.empty()) {
@@ -135,5 +203,10 @@ int main(int argc, char *argv[])
 
     }
 
+    /* only scripts look at this */
+    if (opt_batch && (failed || !err.empty())) {
+        return EXIT_FAILURE;
+    }
+
     return 0;
 }
@@ -19,63 +19,206 @@
 
 #include <boost/xpressive/xpressive.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cstdlib>
 #include <ctime>
+#include <new>
+#include <type_traits>
 #include <sstream>
 
 #include "pcursesexception.h"
+#include "stringpool.h"
 
+using boost::string_ref;
 using std::string;
 using std::vector;
 using boost::xpressive::regex_constants::icase;
 using boost::xpressive::sregex;
 using boost::xpressive::smatch;
 
-Package::Package(alpm_pkg_t *pkg, alpm_db_t *localdb)
+std::mutex Package::alpmmutex;
+std::function<alpm_pkg_t *(string_ref)> Package::localresolver;
+std::function<int(const Package *)> Package::colresolver;
+std::function<string_ref(const Package *)> Package::rootresolver;
+
+static_assert(std::is_trivially_destructible<Package>::value,
+              "packages live in a StringPool and are never destructed");
+
+Package *Package::create(alpm_pkg_t *pkg, alpm_db_t *localdb,
+                         StringPool &pool, StringPool &lazypool, bool lazy)
 {
-    alpm_pkg_t *_pkg = pkg;
-    alpm_pkg_t *_localpkg = alpm_db_get_pkg(localdb, alpm_pkg_get_name(_pkg));
+    void *mem = pool.allocate(sizeof(Package), alignof(Package));
+    return new (mem) Package(pkg, localdb, pool, lazypool, lazy);
+}
 
-    _name = trimstr(alpm_pkg_get_name(_pkg));
-    _url = trimstr(alpm_pkg_get_url(_pkg));
-    _packager = trimstr(alpm_pkg_get_packager(_pkg));
-    _desc = trimstr(alpm_pkg_get_desc(_pkg));
-    _version = trimstr(alpm_pkg_get_version(_pkg));
-    _dbname = trimstr(alpm_db_get_name(alpm_pkg_get_db(_pkg)));
+Package::Package(alpm_pkg_t *pkg, alpm_db_t *localdb,
+                 StringPool &pool, StringPool &lazypool, bool lazy)
+    : _computed(0)
+{
+    _pkg = pkg;
+    _localpkg = alpm_db_get_pkg(localdb, alpm_pkg_get_name(_pkg));
+    _lazypool = lazy ? &lazypool : &pool;
+
+    _name = pool.store(trimstr(alpm_pkg_get_name(_pkg)));
+    _url = pool.store(trimstr(alpm_pkg_get_url(_pkg)));
+    _packager = pool.intern(trimstr(alpm_pkg_get_packager(_pkg)));
+    _desc = pool.store(trimstr(alpm_pkg_get_desc(_pkg)));
+    _lname = pool.lower(_name);
+    _ldesc = pool.lower(_desc);
+    _version = pool.store(trimstr(alpm_pkg_get_version(_pkg)));
+    _versionkey = pool.intern(versionkey(_version));
+    _dbname = pool.intern(trimstr(alpm_db_get_name(alpm_pkg_get_db(_pkg))));
     _builddate = alpm_pkg_get_builddate(_pkg);
-    _arch = trimstr(alpm_pkg_get_arch(_pkg));
+    _arch = pool.intern(trimstr(alpm_pkg_get_arch(_pkg)));
 
     _size = alpm_pkg_get_size(_pkg);
     _installsize = alpm_pkg_get_isize(_pkg);
 
-    _sizestr = size2str(_size);
-    _installsizestr = size2str(_installsize);
+    _sizestr = pool.intern(size2str(_size));
+    _installsizestr = pool.intern(size2str(_installsize));
+
+    _licenses = pool.intern(list2str(alpm_pkg_get_licenses(_pkg), " "));
+    _groups = pool.intern(list2str(alpm_pkg_get_groups(_pkg), " "));
+
+    _signature = signaturetostr(alpm_pkg_get_base64_sig(_pkg) != NULL);
+
+    initlocal(pool);
+
+    if (!lazy) {
+        for (uint f = 1; f < LF_ALL; f <<= 1) {
+            computefield((LazyFieldEnum)f);
+        }
+        _computed = LF_ALL;
+    }
+}
+
+Package *Package::create(alpm_pkg_t *pkg, const Package &installed,
+                         StringPool &pool, StringPool &lazypool, bool lazy)
+{
+    /* _version is trimmed, libalpm's versions never need it */
+    if (installed._version != alpm_pkg_get_version(pkg) ||
+        installed._builddate != alpm_pkg_get_builddate(pkg)) {
+        return create(pkg, alpm_pkg_get_db(installed._pkg), pool, lazypool, lazy);
+    }
 
-    _licenses = list2str(alpm_pkg_get_licenses(_pkg), " ");
-    _groups = list2str(alpm_pkg_get_groups(_pkg), " ");
+    void *mem = pool.allocate(sizeof(Package), alignof(Package));
+    return new (mem) Package(pkg, installed, pool, lazypool, lazy);
+}
+
+Package::Package(alpm_pkg_t *pkg, const Package &installed,
+                 StringPool &pool, StringPool &lazypool, bool lazy)
+    : _pkg(pkg), _localpkg(installed._pkg), _lazypool(lazy ? &lazypool : &pool),
+      _name(installed._name), _url(installed._url), _packager(installed._packager),
+      _desc(installed._desc), _version(installed._version), _arch(installed._arch),
+      _licenses(installed._licenses), _groups(installed._groups),
+      _installsizestr(installed._installsizestr), _localversion(installed._version),
+      _lname(installed._lname), _ldesc(installed._ldesc),
+      _versionkey(installed._versionkey),
+      _computed(0),
+      _installsize(installed._installsize), _builddate(installed._builddate),
+      _updatestate(USE_UPTODATE), _reason(installed._reason)
+{
+    /* what a sync db has to say about the same build */
+    _dbname = pool.intern(trimstr(alpm_db_get_name(alpm_pkg_get_db(_pkg))));
+    _size = alpm_pkg_get_size(_pkg);
+    _sizestr = pool.intern(size2str(_size));
+    _signature = signaturetostr(alpm_pkg_get_base64_sig(_pkg) != NULL);
 
-    _optdepends = deplist2str(alpm_pkg_get_optdepends(_pkg),
-                              "\n            "); /* line up correctly in info pane */
-    _conflicts = deplist2str(alpm_pkg_get_conflicts(_pkg), " ");
-    _provides = deplist2str(alpm_pkg_get_provides(_pkg), " ");
-    _replaces = deplist2str(alpm_pkg_get_replaces(_pkg), " ");
-    _depends = deplist2str(alpm_pkg_get_depends(_pkg), " ");
+    if (!lazy) {
+        for (uint f = 1; f < LF_ALL; f <<= 1) {
+            computefield((LazyFieldEnum)f);
+        }
+        _computed = LF_ALL;
+    }
+}
 
-    _signature = alpm_pkg_get_base64_sig(_pkg) ? "Yes" : "None";
+bool Package::sharesstrings(const Package &other) const
+{
+    return _name.data() == other._name.data();
+}
+
+Package *Package::create(const Fields &fields, StringPool &pool, StringPool &lazypool)
+{
+    void *mem = pool.allocate(sizeof(Package), alignof(Package));
+    return new (mem) Package(fields, pool, lazypool);
+}
 
+Package::Package(const Fields &fields, StringPool &pool, StringPool &lazypool)
+    : _pkg(NULL), _localpkg(NULL), _lazypool(&lazypool),
+      _name(fields.name), _url(fields.url), _packager(fields.packager),
+      _desc(fields.desc), _version(fields.version), _dbname(fields.dbname),
+      _arch(fields.arch), _licenses(fields.licenses), _groups(fields.groups),
+      _sizestr(fields.sizestr), _signature(fields.signature),
+      _installsizestr(fields.installsizestr), _localversion(fields.localversion),
+      _lname(fields.lname), _ldesc(fields.ldesc),
+      _depends(fields.depends), _versionstr(fields.versionstr),
+      _builddatestr(fields.builddatestr), _optdepends(fields.optdepends),
+      _conflicts(fields.conflicts), _provides(fields.provides),
+      _replaces(fields.replaces),
+      _computed(LF_ALL & ~(LF_REQUIREDBY | LF_OPTIONALFOR)),
+      _index(0),
+      _size(fields.size), _installsize(fields.installsize),
+      _builddate(fields.builddate), _updatestate(fields.updatestate),
+      _reason(fields.reason), op(OE_INSTALL_EXPLICIT)
+{
+    _versionkey = pool.intern(versionkey(_version));
+}
+
+void Package::getfields(Fields &fields, StringPool &scratch) const
+{
+    std::lock_guard<std::mutex> lock(alpmmutex);
+
+    /* fields nobody has asked for yet are not kept, they would take up
+       the lazy pool for good */
+    const uint computed = _computed.load(std::memory_order_relaxed);
+    const auto value = [this, computed, &scratch] (LazyFieldEnum f) {
+        return (computed & f) ? lazystr(f) : renderfield(f, scratch);
+    };
+
+    fields.name = _name;
+    fields.url = _url;
+    fields.packager = _packager;
+    fields.desc = _desc;
+    fields.version = _version;
+    fields.dbname = _dbname;
+    fields.arch = _arch;
+    fields.licenses = _licenses;
+    fields.groups = _groups;
+    fields.sizestr = _sizestr;
+    fields.signature = _signature;
+    fields.installsizestr = _installsizestr;
+    fields.localversion = _localversion;
+    fields.lname = _lname;
+    fields.ldesc = _ldesc;
+    fields.depends = value(LF_DEPENDS);
+    fields.versionstr = value(LF_VERSION);
+    fields.builddatestr = value(LF_BUILDDATE);
+    fields.optdepends = value(LF_OPTDEPENDS);
+    fields.conflicts = value(LF_CONFLICTS);
+    fields.provides = value(LF_PROVIDES);
+    fields.replaces = value(LF_REPLACES);
+    fields.size = _size;
+    fields.installsize = _installsize;
+    fields.builddate = _builddate;
+    fields.updatestate = _updatestate;
+    fields.reason = _reason;
+}
+
+void Package::setlocalresolver(const std::function<alpm_pkg_t *(string_ref)> &resolver)
+{
+    std::lock_guard<std::mutex> lock(alpmmutex);
+    localresolver = resolver;
+}
+
+void Package::initlocal(StringPool &pool)
+{
     if (_localpkg == NULL) {
+        _localversion = string_ref();
         _updatestate = USE_NOTINSTALLED;
     } else {
-        _localversion = alpm_pkg_get_version(_localpkg);
-        _updatestate = (alpm_pkg_vercmp(_version.c_str(), _localversion.c_str()) > 0) ?
+        _localversion = pool.store(alpm_pkg_get_version(_localpkg));
+        _updatestate = (alpm_pkg_vercmp(_version.data(), _localversion.data()) > 0) ?
                        USE_UPDATEAVAILABLE : USE_UPTODATE;
-
-        alpm_list_t *requiredbylist = alpm_pkg_compute_requiredby(_localpkg);
-        _requiredby = list2str(requiredbylist, " ");
-        alpm_list_free(requiredbylist);
-
-        alpm_list_t *optionalforlist = alpm_pkg_compute_optionalfor(_localpkg);
-        _optionalfor = list2str(optionalforlist, " ");
-        alpm_list_free(optionalforlist);
     }
 
     _reason = ((_localpkg == NULL) ? IRE_NOTINSTALLED :
@@ -83,6 +226,221 @@ Package::Package(alpm_pkg_t *pkg, alpm_db_t *localdb)
                IRE_EXPLICIT);
 }
 
+void Package::rebase(alpm_pkg_t *pkg, alpm_pkg_t *localpkg)
+{
+    std::lock_guard<std::mutex> lock(alpmmutex);
+
+    if (_pkg != NULL && pkg != NULL) {
+        _pkg = pkg;
+    }
+    _localpkg = localpkg;
+
+    /* the local db may have changed, these are computed again */
+    _requiredby = string_ref();
+    _optionalfor = string_ref();
+    _computed &= ~(LF_REQUIREDBY | LF_OPTIONALFOR);
+}
+
+size_t Package::poolbytes() const
+{
+    /* interned strings are shared, lower case copies may be the original */
+    size_t bytes = sizeof(Package) + _name.size() + _url.size() + _desc.size()
+                   + _version.size() + _localversion.size();
+    if (_lname.data() != _name.data()) {
+        bytes += _lname.size();
+    }
+    if (_ldesc.data() != _desc.data()) {
+        bytes += _ldesc.size();
+    }
+    return bytes;
+}
+
+void Package::setlocal(alpm_pkg_t *localpkg)
+{
+    std::lock_guard<std::mutex> lock(alpmmutex);
+
+    _localpkg = localpkg;
+    initlocal(*_lazypool);
+
+    /* these depend on the local package as well */
+    _requiredby = string_ref();
+    _optionalfor = string_ref();
+    _computed &= ~(LF_VERSION | LF_REQUIREDBY | LF_OPTIONALFOR);
+}
+
+std::mutex &Package::alpmlock()
+{
+    return alpmmutex;
+}
+
+void Package::ensurecomputed(LazyFieldEnum f) const
+{
+    if (_computed.load(std::memory_order_acquire) & f) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(alpmmutex);
+
+    /* another thread might have been quicker */
+    if (_computed.load(std::memory_order_relaxed) & f) {
+        return;
+    }
+
+    computefield(f);
+    _computed.fetch_or(f, std::memory_order_release);
+}
+
+uint Package::lazyfield(AttributeEnum attr)
+{
+    switch (attr) {
+    case A_VERSION:
+        return LF_VERSION;
+    case A_BUILDDATE:
+        return LF_BUILDDATE;
+    case A_DEPENDS:
+        return LF_DEPENDS;
+    case A_OPTDEPENDS:
+        return LF_OPTDEPENDS;
+    case A_CONFLICTS:
+        return LF_CONFLICTS;
+    case A_PROVIDES:
+        return LF_PROVIDES;
+    case A_REPLACES:
+        return LF_REPLACES;
+    case A_REQUIREDBY:
+        return LF_REQUIREDBY;
+    case A_OPTIONALFOR:
+        return LF_OPTIONALFOR;
+    default:
+        return 0;
+    }
+}
+
+void Package::computefield(LazyFieldEnum f) const
+{
+    alpm_list_t *l;
+
+    switch (f) {
+    case LF_REQUIREDBY:
+        if (_pkg == NULL && _localpkg == NULL && _reason != IRE_NOTINSTALLED && localresolver) {
+            _localpkg = localresolver(_name);
+        }
+        if (_localpkg != NULL) {
+            l = alpm_pkg_compute_requiredby(_localpkg);
+            _requiredby = _lazypool->store(list2str(l, " "));
+            alpm_list_free_inner(l, free);
+            alpm_list_free(l);
+        }
+        break;
+    case LF_OPTIONALFOR:
+        if (_pkg == NULL && _localpkg == NULL && _reason != IRE_NOTINSTALLED && localresolver) {
+            _localpkg = localresolver(_name);
+        }
+        if (_localpkg != NULL) {
+            l = alpm_pkg_compute_optionalfor(_localpkg);
+            _optionalfor = _lazypool->store(list2str(l, " "));
+            alpm_list_free_inner(l, free);
+            alpm_list_free(l);
+        }
+        break;
+    default:
+        lazystr(f) = renderfield(f, *_lazypool);
+        break;
+    }
+}
+
+string_ref Package::renderfield(LazyFieldEnum f, StringPool &pool) const
+{
+    switch (f) {
+    case LF_DEPENDS:
+        return pool.store(deplist2str(alpm_pkg_get_depends(_pkg), " "));
+    case LF_OPTDEPENDS:
+        return pool.store(deplist2str(alpm_pkg_get_optdepends(_pkg),
+                                      "\n            ")); /* line up correctly in info pane */
+    case LF_CONFLICTS:
+        return pool.store(deplist2str(alpm_pkg_get_conflicts(_pkg), " "));
+    case LF_PROVIDES:
+        return pool.store(deplist2str(alpm_pkg_get_provides(_pkg), " "));
+    case LF_REPLACES:
+        return pool.store(deplist2str(alpm_pkg_get_replaces(_pkg), " "));
+    case LF_VERSION:
+        if (_updatestate == USE_UPDATEAVAILABLE) {
+            return pool.store(_version.to_string() + " (local: "
+                              + _localversion.to_string() + ")");
+        }
+        return _version;
+    case LF_BUILDDATE: {
+        char timestr[32];
+        if (ctime_r(&_builddate, timestr) == NULL) {
+            timestr[0] = '\0';
+        }
+        string_ref t = timestr;
+        return pool.store(t.substr(0, t.find('\n'))); //remove newline
+    }
+    default:
+        throw PcursesException("Invalid lazy field passed.");
+    }
+}
+
+string_ref &Package::lazystr(LazyFieldEnum f) const
+{
+    switch (f) {
+    case LF_DEPENDS:
+        return _depends;
+    case LF_OPTDEPENDS:
+        return _optdepends;
+    case LF_CONFLICTS:
+        return _conflicts;
+    case LF_PROVIDES:
+        return _provides;
+    case LF_REPLACES:
+        return _replaces;
+    case LF_REQUIREDBY:
+        return _requiredby;
+    case LF_OPTIONALFOR:
+        return _optionalfor;
+    case LF_VERSION:
+        return _versionstr;
+    case LF_BUILDDATE:
+        return _builddatestr;
+    default:
+        throw PcursesException("Invalid lazy field passed.");
+    }
+}
+
+const char *Package::reasontostr(InstallReasonEnum reason)
+{
+    switch (reason) {
+    case IRE_NOTINSTALLED:
+        return "not installed";
+    case IRE_EXPLICIT:
+        return "explicit";
+    case IRE_ASDEPS:
+        return "as dependency";
+    default:
+        throw PcursesException("no package install reason.");
+    }
+}
+
+const char *Package::updatestatetostr(UpdateStateEnum state)
+{
+    switch (state) {
+    case USE_NOTINSTALLED:
+        return "not installed";
+    case USE_UPDATEAVAILABLE:
+        return "update available";
+    case USE_UPTODATE:
+        return "up to date";
+    default:
+        throw PcursesException("no package update state.");
+    }
+}
+
+const char *Package::signaturetostr(bool signature)
+{
+    return signature ? "Yes" : "None";
+}
+
 string Package::size2str(off_t size)
 {
     std::stringstream ss;
@@ -103,20 +461,109 @@ string Package::size2str(off_t size)
     return ss.str();
 }
 
-string Package::trimstr(const char *c) const
+/* libalpm splits versions into runs of digits and runs of letters, anything
+   else separates them. the ctype functions depend on the locale. */
+static bool isverdigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool isveralpha(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Appends the segments of s to key, mirroring rpmvercmp(): a letter segment
+   is older than the end of a version (1.0rc1 < 1.0), which is older than a
+   digit segment (1.0 < 1.0.1). each segment is a type byte, the length of the
+   preceding separator and its value: digits without leading zeros behind
+   their count, or letters behind a terminating NUL. */
+static void appendsegments(string_ref s, string &key)
+{
+    const char SEG_ALPHA = 1, SEG_END = 2, SEG_DIGIT = 3;
+
+    size_t i = 0;
+    while (true) {
+        size_t sep = 0;
+        while (i < s.size() && !isverdigit(s[i]) && !isveralpha(s[i])) {
+            i++;
+            sep++;
+        }
+        if (i == s.size()) {
+            key += SEG_END;
+            return;
+        }
+
+        const size_t start = i;
+        const bool digits = isverdigit(s[i]);
+        while (i < s.size() && (digits ? isverdigit(s[i]) : isveralpha(s[i]))) {
+            i++;
+        }
+        string_ref seg = s.substr(start, i - start);
+
+        key += digits ? SEG_DIGIT : SEG_ALPHA;
+        key += (char)std::min<size_t>(sep, 0xff);
+        if (digits) {
+            while (!seg.empty() && seg.front() == '0') {
+                seg.remove_prefix(1);
+            }
+            const size_t len = std::min<size_t>(seg.size(), 0xffff);
+            key += (char)(len >> 8);
+            key += (char)(len & 0xff);
+            key.append(seg.data(), len);
+        } else {
+            key.append(seg.data(), seg.size());
+            key += '\0';
+        }
+    }
+}
+
+string Package::versionkey(string_ref version)
+{
+    /* [epoch:]pkgver[-pkgrel], split like libalpm's parseEVR() */
+    size_t pos = 0;
+    while (pos < version.size() && isverdigit(version[pos])) {
+        pos++;
+    }
+
+    string_ref epoch("0"),
+               pkgver = version,
+               pkgrel;
+
+    const size_t dash = version.rfind('-');
+    if (dash != string_ref::npos && dash >= pos) {
+        pkgrel = version.substr(dash + 1);
+        pkgver = version.substr(0, dash);
+    }
+    if (pos < pkgver.size() && pkgver[pos] == ':') {
+        if (pos > 0) {
+            epoch = pkgver.substr(0, pos);
+        }
+        pkgver.remove_prefix(pos + 1);
+    }
+
+    string key;
+    key.reserve(2 * version.size() + 16);
+    appendsegments(epoch, key);
+    appendsegments(pkgver, key);
+    appendsegments(pkgrel, key);
+    return key;
+}
+
+string_ref Package::trimstr(const char *c) const
 {
     if (c == NULL) {
         return "";
     }
 
-    string str = c;
+    string_ref str = c;
 
     /* trim string */
 
     size_t startpos = str.find_first_not_of(" \t\n");
     size_t endpos = str.find_last_not_of(" \t\n");
 
-    if ((string::npos == startpos) || (string::npos == endpos)) {
+    if ((string_ref::npos == startpos) || (string_ref::npos == endpos)) {
         return "";
     } else {
         return str.substr(startpos, endpos - startpos + 1);
@@ -130,7 +577,9 @@ string Package::deplist2str(alpm_list_t *l, string delim) const
     string res = "";
     for (alpm_list_t *deps = l; deps != NULL; deps = alpm_list_next(deps)) {
         alpm_depend_t *depend = (alpm_depend_t *)deps->data;
-        res += alpm_dep_compute_string(depend);
+        char *depstr = alpm_dep_compute_string(depend);
+        res += depstr;
+        free(depstr);
         if (deps->next != NULL) {
             res += delim;
         }
@@ -152,52 +601,97 @@ string Package::list2str(alpm_list_t *l, string delim) const
 }
 
 string Package::getattr(AttributeEnum attr) const
+{
+    return getstrattr(attr).to_string();
+}
+
+bool Package::haslowerattr(AttributeEnum attr)
+{
+    return attr == A_NAME || attr == A_DESC;
+}
+
+string_ref Package::getlowerattr(AttributeEnum attr) const
+{
+    return (attr == A_NAME) ? _lname : _ldesc;
+}
+
+bool Package::trygetstrattr(AttributeEnum attr, string_ref &str) const
+{
+    const uint f = lazyfield(attr);
+
+    if (f != 0 && (_computed.load(std::memory_order_acquire) & f) == 0) {
+        std::unique_lock<std::mutex> lock(alpmmutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return false;
+        }
+        if ((_computed.load(std::memory_order_relaxed) & f) == 0) {
+            computefield((LazyFieldEnum)f);
+            _computed.fetch_or(f, std::memory_order_release);
+        }
+    }
+
+    str = getstrattr(attr);
+    return true;
+}
+
+string_ref Package::getstrattr(AttributeEnum attr) const
 {
     switch (attr) {
     case A_NAME:
-        return getname();
+        return _name;
     case A_VERSION:
-        return getversion();
+        ensurecomputed(LF_VERSION);
+        return _versionstr;
     case A_URL:
-        return geturl();
+        return _url;
     case A_REPO:
-        return getrepo();
+        return _dbname;
     case A_PACKAGER:
-        return getpackager();
+        return _packager;
     case A_BUILDDATE:
-        return getbuilddate();
+        ensurecomputed(LF_BUILDDATE);
+        return _builddatestr;
     case A_INSTALLSTATE:
-        return getreason();
+        return reasontostr(_reason);
     case A_UPDATESTATE:
-        return getupdatestate();
+        return updatestatetostr(_updatestate);
     case A_DESC:
-        return getdesc();
+        return _desc;
     case A_ARCH:
-        return getarch();
+        return _arch;
     case A_LICENSES:
-        return getlicenses();
+        return _licenses;
     case A_GROUPS:
-        return getgroups();
+        return _groups;
     case A_DEPENDS:
-        return getdepends();
+        ensurecomputed(LF_DEPENDS);
+        return _depends;
     case A_OPTDEPENDS:
-        return getoptdepends();
+        ensurecomputed(LF_OPTDEPENDS);
+        return _optdepends;
     case A_CONFLICTS:
-        return getconflicts();
+        ensurecomputed(LF_CONFLICTS);
+        return _conflicts;
     case A_PROVIDES:
-        return getprovides();
+        ensurecomputed(LF_PROVIDES);
+        return _provides;
     case A_REPLACES:
-        return getreplaces();
+        ensurecomputed(LF_REPLACES);
+        return _replaces;
     case A_REQUIREDBY:
-        return getrequiredby();
+        ensurecomputed(LF_REQUIREDBY);
+        return _requiredby;
     case A_OPTIONALFOR:
-        return getoptionalfor();
+        ensurecomputed(LF_OPTIONALFOR);
+        return _optionalfor;
     case A_SIGNATURE:
-        return getsignature();
+        return _signature;
     case A_SIZE:
-        return getsize();
+        return _sizestr;
     case A_ISIZE:
-        return getisize();
+        return _installsizestr;
+    case A_ROOTS:
+        return rootresolver ? rootresolver(this) : string_ref();
     case A_NONE:
         return "";
     default:
@@ -205,160 +699,159 @@ string Package::getattr(AttributeEnum attr) const
     }
 }
 
-off_t Package::getoffattr(AttributeEnum attr) const
+int64_t Package::getnumattr(AttributeEnum attr) const
 {
     switch (attr) {
     case A_BUILDDATE:
-        return (off_t)_builddate;
+        return (int64_t)_builddate;
     case A_SIZE:
         return _size;
     case A_ISIZE:
         return _installsize;
+    case A_INSTALLSTATE:
+        return _reason;
+    case A_UPDATESTATE:
+        return _updatestate;
+    case A_SIGNATURE:
+        return (_signature == "Yes") ? 1 : 0;
     default:
         throw PcursesException("Invalid attribute passed.");
     }
 }
 
-void Package::setcolindex(int index)
+void Package::setcolresolver(const std::function<int(const Package *)> &resolver)
 {
-    _colindex = index;
+    colresolver = resolver;
 }
 
 int Package::getcolindex() const
 {
-    return _colindex;
+    return colresolver ? colresolver(this) : 0;
+}
+
+void Package::setrootresolver(const std::function<string_ref(const Package *)> &resolver)
+{
+    rootresolver = resolver;
+}
+
+void Package::setindex(uint index)
+{
+    _index = index;
+}
+
+uint Package::getindex() const
+{
+    return _index;
 }
 
 string Package::getname() const
 {
-    return _name;
+    return getattr(A_NAME);
 }
 
 string Package::getdesc() const
 {
-    return _desc;
+    return getattr(A_DESC);
 }
 
 string Package::getversion() const
 {
-    if (_updatestate == USE_UPDATEAVAILABLE) {
-        return _version + " (local: " + _localversion + ")";
-    }
-    return _version;
+    return getattr(A_VERSION);
 }
 
 string Package::getrepo() const
 {
-    return _dbname;
+    return getattr(A_REPO);
 }
 
 string Package::getreason() const
 {
-    switch (_reason) {
-    case IRE_NOTINSTALLED:
-        return "not installed";
-    case IRE_EXPLICIT:
-        return "explicit";
-    case IRE_ASDEPS:
-        return "as dependency";
-    default:
-        throw PcursesException("no package install reason.");
-    }
+    return getattr(A_INSTALLSTATE);
 }
 
 string Package::getpackager() const
 {
-    return _packager;
+    return getattr(A_PACKAGER);
 }
 
 string Package::geturl() const
 {
-    return _url;
+    return getattr(A_URL);
 }
 
 string Package::getbuilddate() const
 {
-    string timestr = std::ctime(&_builddate);
-    return timestr.substr(0, timestr.length() - 1); //remove newline
+    return getattr(A_BUILDDATE);
 }
 
 string Package::getarch() const
 {
-    return _arch;
+    return getattr(A_ARCH);
 }
 
 string Package::getlicenses() const
 {
-    return _licenses;
+    return getattr(A_LICENSES);
 }
 
 string Package::getgroups() const
 {
-    return _groups;
+    return getattr(A_GROUPS);
 }
 
 string Package::getdepends() const
 {
-    return _depends;
+    return getattr(A_DEPENDS);
 }
 
 string Package::getoptdepends() const
 {
-    return _optdepends;
+    return getattr(A_OPTDEPENDS);
 }
 
 string Package::getconflicts() const
 {
-    return _conflicts;
+    return getattr(A_CONFLICTS);
 }
 
 string Package::getprovides() const
 {
-    return _provides;
+    return getattr(A_PROVIDES);
 }
 
 string Package::getreplaces() const
 {
-    return _replaces;
+    return getattr(A_REPLACES);
 }
 
 string Package::getrequiredby() const
 {
-    return _requiredby;
+    return getattr(A_REQUIREDBY);
 }
 
 string Package::getoptionalfor() const
 {
-    return _optionalfor;
+    return getattr(A_OPTIONALFOR);
 }
 
 string Package::getsignature() const
 {
-    return _signature;
+    return getattr(A_SIGNATURE);
 }
 
 string Package::getsize() const
 {
-    return _sizestr;
+    return getattr(A_SIZE);
 }
 
 string Package::getisize() const
 {
-    return _installsizestr;
+    return getattr(A_ISIZE);
 }
 
 string Package::getupdatestate() const
 {
-    switch (_updatestate) {
-    case USE_NOTINSTALLED:
-        return "not installed";
-    case USE_UPDATEAVAILABLE:
-        return "update available";
-    case USE_UPTODATE:
-        return "up to date";
-    default:
-        throw PcursesException("no package update state.");
-    }
+    return getattr(A_UPDATESTATE);
 }
 
 void Package::setop(OperationEnum oe)
@@ -19,11 +19,18 @@
 #define PACKAGE_H
 
 #include <alpm.h>
+#include <atomic>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "attributeinfo.h"
 
+class StringPool;
+
 typedef struct __alpm_pkg_t alpm_pkg_t;
 
 enum InstallReasonEnum {
@@ -49,7 +56,99 @@ enum OperationEnum {
 class Package
 {
 public:
-    Package(alpm_pkg_t *pkg, alpm_db_t *localdb);
+    /* Creates a package inside pool, which backs all of its strings.
+       Packages are never deleted, they are freed by releasing the pool.
+       In lazy mode, the expensive fields (dependency lists, required by and
+       optionally required by) are only computed once they are first requested
+       and are stored in lazypool. pkg, localdb and lazypool must then stay valid
+       during the whole lifetime of the package. lazypool may be shared by
+       several packages (and threads). */
+    static Package *create(alpm_pkg_t *pkg, alpm_db_t *localdb,
+                           StringPool &pool, StringPool &lazypool, bool lazy = true);
+
+    /* Like the above for the sync package pkg of an installed package, which
+       must have been created from its local db entry. If both are the same
+       build (version and build date), installed's strings are shared and
+       only what differs in a sync db is read from pkg. installed must not
+       change while this runs. */
+    static Package *create(alpm_pkg_t *pkg, const Package &installed,
+                           StringPool &pool, StringPool &lazypool, bool lazy = true);
+
+    /* True if this package shares its strings with other, i.e. one has
+       been created from the other. */
+    bool sharesstrings(const Package &other) const;
+
+    /* Attribute values of a package, without 'Required by' and 'Optionally
+       required by', which need libalpm. */
+    struct Fields {
+        boost::string_ref name,
+              url,
+              packager,
+              desc,
+              version,
+              dbname,
+              arch,
+              licenses,
+              groups,
+              sizestr,
+              signature,
+              installsizestr,
+              localversion,
+              lname,
+              ldesc,
+              depends,
+              versionstr,
+              builddatestr,
+              optdepends,
+              conflicts,
+              provides,
+              replaces;
+
+        int64_t size,
+                installsize,
+                builddate;
+
+        UpdateStateEnum updatestate;
+        InstallReasonEnum reason;
+    };
+
+    /* Creates a package from plain values, inside pool. The strings are not
+       copied and must outlive the package. They need to be followed by
+       StrSearch::PADDING readable bytes (like StringPool strings are).
+       'Required by' and 'Optionally required by' are taken from the local
+       package returned by the resolver (see setlocalresolver()). */
+    static Package *create(const Fields &fields, StringPool &pool, StringPool &lazypool);
+
+    /* Stores all attribute values in fields. Fields which have not been
+       computed yet are rendered into scratch instead of being kept. The
+       strings stay valid for the lifetime of the package and scratch. */
+    void getfields(Fields &fields, StringPool &scratch) const;
+
+    /* Sets the function which finds the local libalpm package of packages
+       created from plain values. It is called with all libalpm access
+       serialized, and may return NULL. */
+    static void setlocalresolver(const std::function<alpm_pkg_t *(boost::string_ref)> &resolver);
+
+    /* Moves the package to another handle, which holds the same data for
+       it. pkg (if not NULL) replaces the libalpm package, packages created
+       from plain values keep none. localpkg replaces the local package.
+       Nothing is computed, 'Required by' and 'Optionally required by' are
+       computed again when they are needed. */
+    void rebase(alpm_pkg_t *pkg, alpm_pkg_t *localpkg);
+
+    /* Rough number of bytes the package and its own strings take up in
+       the pool it was created in. */
+    size_t poolbytes() const;
+
+    /* Takes install reason, update state and local version from localpkg,
+       which is NULL if the package is not installed (anymore). For packages
+       created from plain values, localpkg must stay valid during the
+       package's lifetime. */
+    void setlocal(alpm_pkg_t *localpkg);
+
+    /* Serializes libalpm access. Must be held by anything else calling into
+       libalpm while packages might compute fields. */
+    static std::mutex &alpmlock();
 
     std::string getarch() const;
     std::string getbuilddate() const;
@@ -75,43 +174,155 @@ public:
     std::string getversion() const;
 
     std::string getattr(AttributeEnum attr) const;
-    off_t getoffattr(AttributeEnum attr) const;
 
-    void setcolindex(int index);
+    /* version of the package itself, without the local version.
+       NUL terminated, for passing to alpm_pkg_vercmp(). */
+    boost::string_ref getrawversion() const
+    {
+        return _version;
+    }
+
+    /* Key of the version (see versionkey()), stored in the package pool */
+    boost::string_ref getversionkey() const
+    {
+        return _versionkey;
+    }
+
+    /* installed version, empty if the package is not installed */
+    boost::string_ref getlocalversion() const
+    {
+        return _localversion;
+    }
+
+    /* Zero-copy access to the display string of attr. The reference stays
+       valid for the lifetime of the package. */
+    boost::string_ref getstrattr(AttributeEnum attr) const;
+
+    /* Like getstrattr(), but returns false instead of waiting if attr is
+       computed on demand and the alpm lock is held elsewhere, for example
+       while the loader reads a db. */
+    bool trygetstrattr(AttributeEnum attr, boost::string_ref &str) const;
+
+    /* Numeric value of attr: a timestamp for build date, bytes for the sizes,
+       the enum value for install and update state and 0/1 for signature. */
+    int64_t getnumattr(AttributeEnum attr) const;
+
+    /* Lower case copies of name and description, kept for fast searching.
+       They are followed by StrSearch::PADDING readable bytes. */
+    static bool haslowerattr(AttributeEnum attr);
+    boost::string_ref getlowerattr(AttributeEnum attr) const;
+
+    /* Sets the function which tells the color group of a package, it is
+       asked whenever the package is drawn. */
+    static void setcolresolver(const std::function<int(const Package *)> &resolver);
     int getcolindex() const;
 
+    /* Sets the function which tells the A_ROOTS string of a package. It may
+       be called from several threads at once. */
+    static void setrootresolver(const std::function<boost::string_ref(const Package *)> &resolver);
+
+    /* position in the (name sorted) list of all packages */
+    void setindex(uint index);
+    uint getindex() const;
+
     void setop(OperationEnum oe);
     OperationEnum getop() const;
 
+    static std::string size2str(off_t size);
+
+    /* Encodes version so that comparing keys bytewise orders versions like
+       alpm_pkg_vercmp(), and equal versions (1.0 and 1.00) get equal keys.
+       Unlike vercmp, this is a strict weak ordering: it differs where
+       separator lengths and segment types disagree (vercmp is not
+       transitive there) and when only one version has a pkgrel, which
+       orders before all others. */
+    static std::string versionkey(boost::string_ref version);
+    static const char *reasontostr(InstallReasonEnum reason);
+    static const char *updatestatetostr(UpdateStateEnum state);
+    static const char *signaturetostr(bool signature);
+
 private:
 
-    std::string trimstr(const char *c) const;
+    Package(alpm_pkg_t *pkg, alpm_db_t *localdb,
+            StringPool &pool, StringPool &lazypool, bool lazy);
+    Package(alpm_pkg_t *pkg, const Package &installed,
+            StringPool &pool, StringPool &lazypool, bool lazy);
+    Package(const Fields &fields, StringPool &pool, StringPool &lazypool);
+
+    /* Fields computed on demand, used as bit flags in _computed. */
+    enum LazyFieldEnum {
+        LF_DEPENDS = 1 << 0,
+        LF_OPTDEPENDS = 1 << 1,
+        LF_CONFLICTS = 1 << 2,
+        LF_PROVIDES = 1 << 3,
+        LF_REPLACES = 1 << 4,
+        LF_REQUIREDBY = 1 << 5,
+        LF_OPTIONALFOR = 1 << 6,
+        LF_VERSION = 1 << 7,
+        LF_BUILDDATE = 1 << 8,
+        LF_ALL = (1 << 9) - 1
+    };
+
+    /* Computes field f unless it has been computed already. Thread safe. */
+    void ensurecomputed(LazyFieldEnum f) const;
+    /* the field computed on demand for attr, 0 for all others */
+    static uint lazyfield(AttributeEnum attr);
+    void computefield(LazyFieldEnum f) const;
+    /* renders f (but not 'Required by' or 'Optionally required by') into
+       pool, without storing it in the package */
+    boost::string_ref renderfield(LazyFieldEnum f, StringPool &pool) const;
+    boost::string_ref &lazystr(LazyFieldEnum f) const;
+    void initlocal(StringPool &pool);
+
+    boost::string_ref trimstr(const char *c) const;
     std::string deplist2str(alpm_list_t *l, std::string delim) const;
     std::string list2str(alpm_list_t *l, std::string delim) const;
-    static std::string size2str(off_t size);
 
-    std::string _name,
-        _url,
-        _packager,
-        _desc,
-        _version,
-        _dbname,
-        _arch,
-        _licenses,
-        _groups,
-        _depends,
-        _optdepends,
-        _conflicts,
-        _provides,
-        _replaces,
-        _requiredby,
-        _optionalfor,
-        _sizestr,
-        _signature,
-        _installsizestr,
-        _localversion;
-
-    int _colindex;
+    /* libalpm is not thread safe, all lazy computations are serialized.
+       this also protects the lazy pools. */
+    static std::mutex alpmmutex;
+
+    static std::function<alpm_pkg_t *(boost::string_ref)> localresolver;
+    static std::function<int(const Package *)> colresolver;
+    static std::function<boost::string_ref(const Package *)> rootresolver;
+
+    /* NULL for packages created from plain values. _localpkg is then
+       resolved once it is needed. */
+    alpm_pkg_t *_pkg;
+    mutable alpm_pkg_t *_localpkg;
+
+    StringPool *_lazypool;
+
+    boost::string_ref _name,
+          _url,
+          _packager,
+          _desc,
+          _version,
+          _dbname,
+          _arch,
+          _licenses,
+          _groups,
+          _sizestr,
+          _signature,
+          _installsizestr,
+          _localversion,
+          _lname,
+          _ldesc,
+          _versionkey;
+
+    mutable boost::string_ref _depends,
+            _versionstr,
+            _builddatestr,
+            _optdepends,
+            _conflicts,
+            _provides,
+            _replaces,
+            _requiredby,
+            _optionalfor;
+
+    mutable std::atomic<uint> _computed;
+
+    uint _index;
 
     off_t _size,
           _installsize;
@@ -0,0 +1,99 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+uint Parallel::threadcount(uint requested)
+{
+    /* hardware_concurrency() may return 0 if the value is not computable */
+    uint cores = std::thread::hardware_concurrency();
+    if (cores == 0) {
+        cores = 1;
+    }
+
+    if (requested == 0) {
+        return cores;
+    }
+
+    /* more threads than this only cost memory, every loader thread has
+       its own pool */
+    return std::min(requested, MAXTHREADSPERCORE * cores);
+}
+
+void Parallel::for_each_chunk(size_t n, uint threads, size_t chunksize,
+                              const std::function<void(size_t, size_t, uint)> &fn)
+{
+    if (n == 0) {
+        return;
+    }
+
+    if (chunksize == 0) {
+        chunksize = 1;
+    }
+
+    const size_t chunks = (n + chunksize - 1) / chunksize;
+    const size_t workers = std::min<size_t>(std::max<uint>(threads, 1), chunks);
+
+    /* no point in spawning anything, run everything right here */
+    if (workers == 1) {
+        fn(0, n, 0);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errormutex;
+
+    const auto work = [&] (uint worker) {
+        size_t chunk;
+        while ((chunk = next++) < chunks) {
+            const size_t begin = chunk * chunksize;
+            const size_t end = std::min(begin + chunksize, n);
+            try {
+                fn(begin, end, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errormutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                /* skip all remaining chunks */
+                next = chunks;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; i++) {
+        pool.push_back(std::thread(work, i));
+    }
+    work(0);
+
+    for (std::thread &t : pool) {
+        t.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,107 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <functional>
+#include <sys/types.h>
+#include <vector>
+
+class Parallel
+{
+public:
+    /* Resolves a configured thread count; 0 means one thread per core.
+       Larger counts are clamped to MAXTHREADSPERCORE threads per core. */
+    static uint threadcount(uint requested);
+
+    /* Splits [0, n) into chunks of chunksize elements and runs
+       fn(begin, end, worker) on each of them using up to threads workers
+       (including the calling thread). worker is in [0, threads) and unique to
+       the thread running the chunk, which allows for per worker state.
+       Chunks are handed out dynamically, so the order in which they are
+       processed is unspecified. The first exception thrown by a worker is
+       rethrown in the calling thread once all workers have finished. */
+    static void for_each_chunk(size_t n, uint threads, size_t chunksize,
+                               const std::function<void(size_t, size_t, uint)> &fn);
+
+    /* Stable sort using up to threads workers. v is split into runs which
+       are sorted in parallel and then merged pairwise, so the result is
+       exactly the one of std::stable_sort. cmp is called concurrently. */
+    template <class T, class Compare>
+    static void stable_sort(std::vector<T> &v, uint threads, Compare cmp);
+
+private:
+    /* runs shorter than this are not worth a thread */
+    static const size_t MINRUN = 1024;
+
+    /* upper bound of configured thread counts */
+    static const uint MAXTHREADSPERCORE = 4;
+};
+
+template <class T, class Compare>
+void Parallel::stable_sort(std::vector<T> &v, uint threads, Compare cmp)
+{
+    const size_t runs = std::min<size_t>(std::max<uint>(threads, 1), v.size() / MINRUN);
+
+    if (runs <= 1) {
+        std::stable_sort(v.begin(), v.end(), cmp);
+        return;
+    }
+
+    /* run r is [bounds[r], bounds[r + 1]) */
+    std::vector<size_t> bounds;
+    for (size_t r = 0; r <= runs; r++) {
+        bounds.push_back(v.size() * r / runs);
+    }
+
+    for_each_chunk(runs, threads, 1, [&] (size_t begin, size_t end, uint) {
+        for (size_t r = begin; r < end; r++) {
+            std::stable_sort(v.begin() + bounds[r], v.begin() + bounds[r + 1], cmp);
+        }
+    });
+
+    /* std::merge prefers the first range on ties, which keeps it stable */
+    std::vector<T> merged(v.size());
+    while (bounds.size() > 2) {
+        const size_t pairs = bounds.size() / 2;
+
+        for_each_chunk(pairs, threads, 1, [&] (size_t begin, size_t end, uint) {
+            for (size_t p = begin; p < end; p++) {
+                const size_t lo = bounds[2 * p],
+                             mid = bounds[std::min(2 * p + 1, bounds.size() - 1)],
+                             hi = bounds[std::min(2 * p + 2, bounds.size() - 1)];
+                std::merge(v.begin() + lo, v.begin() + mid, v.begin() + mid, v.begin() + hi,
+                           merged.begin() + lo, cmp);
+            }
+        });
+
+        std::vector<size_t> next;
+        for (size_t i = 0; i < bounds.size(); i += 2) {
+            next.push_back(bounds[i]);
+        }
+        if (next.back() != v.size()) {
+            next.push_back(v.size());
+        }
+
+        v.swap(merged);
+        bounds.swap(next);
+    }
+}
+
+#endif // PARALLEL_H
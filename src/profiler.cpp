@@ -0,0 +1,220 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/format.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+
+using std::string;
+using std::vector;
+
+/* counted in operator new below, which may run before main() */
+static std::atomic<uint64_t> totalallocs(0),
+       totalbytes(0);
+
+static const Profiler::Clock::time_point processstart = Profiler::Clock::now();
+
+void *operator new(std::size_t size)
+{
+    totalallocs.fetch_add(1, std::memory_order_relaxed);
+    totalbytes.fetch_add(size, std::memory_order_relaxed);
+
+    for (;;) {
+        void *p = std::malloc(size ? size : 1);
+        if (p != NULL) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == NULL) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+/* all forms are replaced, so that allocation and deallocation always match */
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {
+        return operator new(size);
+    } catch (...) {
+        return NULL;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+/* never destroyed, spans may still end during static destruction */
+struct Registry {
+    std::mutex mutex;
+    std::map<string, Profiler::Entry> entries;
+};
+
+static Registry &registry()
+{
+    static Registry *r = new Registry();
+    return *r;
+}
+
+Profiler::Span::Span(const string &n)
+    : name(n), start(Clock::now()),
+      allocs(totalallocs.load(std::memory_order_relaxed)),
+      bytes(totalbytes.load(std::memory_order_relaxed))
+{
+}
+
+Profiler::Span::~Span()
+{
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - start).count();
+    record(name, ns, totalallocs.load(std::memory_order_relaxed) - allocs,
+           totalbytes.load(std::memory_order_relaxed) - bytes);
+}
+
+void Profiler::record(const string &name, uint64_t ns, uint64_t a, uint64_t b)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    Entry &e = r.entries[name];
+    if (e.count == 0) {
+        e.name = name;
+    }
+    e.count++;
+    e.total += ns;
+    e.max = std::max(e.max, ns);
+    e.last = ns;
+    e.allocs += a;
+    e.bytes += b;
+}
+
+vector<Profiler::Entry> Profiler::entries()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    vector<Entry> v;
+    for (const auto &e : r.entries) {
+        v.push_back(e.second);
+    }
+    return v;
+}
+
+Profiler::Entry Profiler::entry(const string &name)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    const auto it = r.entries.find(name);
+    if (it == r.entries.end()) {
+        Entry e = Entry();
+        e.name = name;
+        return e;
+    }
+    return it->second;
+}
+
+uint64_t Profiler::allocations()
+{
+    return totalallocs.load(std::memory_order_relaxed);
+}
+
+uint64_t Profiler::allocatedbytes()
+{
+    return totalbytes.load(std::memory_order_relaxed);
+}
+
+string Profiler::ms(uint64_t ns)
+{
+    return boost::str(boost::format("%.2f") % (ns / 1e6));
+}
+
+void Profiler::report(vector<string> &lines)
+{
+    const char *row = "%-24s %7s %10s %9s %9s %9s %9s %10s";
+
+    lines.push_back(boost::str(boost::format(row) % "operation" % "count" % "total ms"
+                               % "avg ms" % "max ms" % "last ms" % "allocs" % "alloc KB"));
+    for (const Entry &e : entries()) {
+        lines.push_back(boost::str(boost::format(row) % e.name % e.count % ms(e.total)
+                                   % ms(e.total / e.count) % ms(e.max) % ms(e.last)
+                                   % e.allocs % (e.bytes / 1024)));
+    }
+
+    const uint64_t uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                Clock::now() - processstart).count();
+    lines.push_back("");
+    lines.push_back(boost::str(boost::format("%d allocations (%d KB) in %.1f s")
+                               % allocations() % (allocatedbytes() / 1024) % (uptime / 1e9)));
+}
+
+bool Profiler::write(const string &path)
+{
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << "operation\tcount\ttotal_us\tmax_us\tlast_us\tallocs\talloc_bytes\n";
+    for (const Entry &e : entries()) {
+        out << e.name << '\t' << e.count << '\t' << e.total / 1000 << '\t' << e.max / 1000
+            << '\t' << e.last / 1000 << '\t' << e.allocs << '\t' << e.bytes << '\n';
+    }
+
+    const uint64_t uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                Clock::now() - processstart).count();
+    out << "process\t1\t" << uptime / 1000 << '\t' << uptime / 1000 << '\t' << uptime / 1000
+        << '\t' << allocations() << '\t' << allocatedbytes() << '\n';
+
+    out.close();
+    return !out.fail();
+}
@@ -0,0 +1,87 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Keeps track of how long operations take and how much they allocate.
+   Operations are identified by name, all spans of the same name are summed
+   up. Allocations are counted by replacing the global operator new, for all
+   threads. Thread safe. */
+class Profiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /* Measures its own lifetime as one run of the operation name. */
+    class Span
+    {
+    public:
+        explicit Span(const std::string &n);
+        ~Span();
+
+    private:
+        Span(const Span &);
+        Span &operator=(const Span &);
+
+        std::string name;
+        Clock::time_point start;
+        uint64_t allocs,
+                 bytes;
+    };
+
+    struct Entry {
+        std::string name;
+        uint64_t count,
+                 /* in nanoseconds */
+                 total,
+                 max,
+                 last,
+                 allocs,
+                 bytes;
+    };
+
+    /* all operations run so far, sorted by name */
+    static std::vector<Entry> entries();
+
+    /* the entry of name, zeroed if it has not run yet */
+    static Entry entry(const std::string &name);
+
+    /* allocations since the start of the process */
+    static uint64_t allocations();
+    static uint64_t allocatedbytes();
+
+    /* a table of all operations, for display */
+    static void report(std::vector<std::string> &lines);
+
+    /* Writes all operations as tab separated values to path, in
+       microseconds. The last line ("process") has the totals since the
+       start. Returns false on failure. */
+    static bool write(const std::string &path);
+
+    static std::string ms(uint64_t ns);
+
+private:
+    static void record(const std::string &name, uint64_t ns, uint64_t allocs, uint64_t bytes);
+};
+
+#endif // PROFILER_H
@@ -18,25 +18,29 @@
 #include "program.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
 #include <iostream>
+#include <iterator>
 #include <ncurses.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "cursesframe.h"
 #include "curseslistbox.h"
 #include "cursesui.h"
+#include "eventloop.h"
 #include "filter.h"
 #include "package.h"
+#include "parallel.h"
 #include "pcursesexception.h"
+#include "profiler.h"
+#include "query.h"
 
 using std::string;
 using std::vector;
 using std::map;
-using boost::xpressive::regex_constants::icase;
-using boost::xpressive::smatch;
-using boost::xpressive::sregex;
 
 typedef struct __alpm_list_t alpm_list_t;
 
@@ -52,24 +56,92 @@ typedef struct __alpm_list_t alpm_list_t;
 Program::Program()
 {
     quit = false;
+    batch = false;
+    batchfailed = false;
+    loading = false;
+    startuppending = false;
+    handle = NULL;
+    synchandle = NULL;
+    deadbytes = 0;
+    writercancelled = false;
+    liveactive = false;
+    searchstale = false;
+
+    EventLoop::init();
 }
 
 Program::~Program()
 {
     deinit();
+
+    /* a background command keeps running through full reloads, but its
+       reader sends wakeups until it is gone */
+    command.stop();
+    EventLoop::deinit();
 }
 
 void Program::deinit()
 {
-    CursesUi::ui().disable_curses();
-
-    for (uint i = 0; i < packages.size(); i++) {
-        delete packages[i];
+    if (!batch) {
+        CursesUi::ui().disable_curses();
     }
 
+    /* the loader, the snapshot writer and the live filter refer to packages */
+    watcher.stop();
+    loader.cancel();
+    loading = false;
+    startuppending = false;
+    state.progress.clear();
+    stopsnapshotwriter();
+    livefilter.cancel();
+    liveactive = false;
+    livemask.clear();
+
     filteredpackages.clear();
+    sortedpackages.clear();
     packages.clear();
     opqueue.clear();
+    queuedmask.clear();
+    filters.clear();
+    allmask.clear();
+    searchindex.clear();
+    depgraph.clear();
+    filtercache.invalidate();
+    sortcache.reset(packages);
+
+    /* this frees all packages */
+    for (StringPool *pool : pools) {
+        delete pool;
+    }
+    pools.clear();
+    lazypool.release();
+    snapshot.close();
+    snapshotpath.clear();
+    snapshotstamp.clear();
+    dbstamps.clear();
+    Package::setlocalresolver(std::function<alpm_pkg_t *(boost::string_ref)>());
+    Package::setcolresolver(std::function<int(const Package *)>());
+    Package::setrootresolver(std::function<boost::string_ref(const Package *)>());
+    rootversions.clear();
+    rootonly.clear();
+    rootinfo.clear();
+    rootdiffmask.clear();
+    rootpool.release();
+
+    deadbytes = 0;
+
+    int ret = 0;
+    if (synchandle != NULL && synchandle != handle) {
+        ret |= alpm_release(synchandle);
+    }
+    if (handle != NULL) {
+        ret |= alpm_release(handle);
+    }
+    handle = NULL;
+    synchandle = NULL;
+    if (ret != 0) {
+        throw PcursesException("failed to deinitialize alpm library");
+    }
 }
 
 void Program::run_cmd(const string &cmd) const
@@ -77,11 +149,14 @@ void Program::run_cmd(const string &cmd) const
     pid_t pid;
     int status;
 
+    /* allocating after fork() is not safe with threads around */
+    Command::Args args;
+    Command::prepare(cmd, args);
 
     pid = fork();
     if (pid == 0) {
         /* child */
-        execlp("bash", "bash", "-ic", cmd.c_str(), (char *)NULL);
+        Command::exec(args, true);
     } else {
         /* parent (or error, which we blissfully ignore */
 
@@ -102,19 +177,60 @@ void Program::run_cmd(const string &cmd) const
 void Program::init_misc()
 {
     colorcodepackages(state.coloredby);
-    state.searchphrases.clear();
 
-    /* exec startup macro if it exists */
-    execmacro("startup");
+    /* the startup macro is run once all packages are loaded, see pollloader() */
+    startuppending = true;
 }
 
-void Program::init(const char *conf_file)
+void Program::init(const char *conf_file, bool batch)
 {
+    this->batch = batch;
+    batchfailed = false;
+
     if (conf_file != nullptr) {
         conf.setpcursesconffile(conf_file);
     }
 
-    loadpkgs();
+    conf.parse_pacmanconf();
+    conf.parse_pcursesconf();
+    macros = conf.getmacros();
+    roots = configuredroots();
+
+    const uint threads = Parallel::threadcount(conf.getloadthreads());
+    sortcache.setparallel(threads, conf.getparallelthreshold());
+    filtercache.setcapacity(conf.getfiltercache());
+    for (uint i = 0; i < threads; i++) {
+        pools.push_back(new StringPool());
+    }
+
+    sortcache.reset(packages);
+    sortall();
+    updateview();
+
+    /* the groups of each attribute are kept until the packages change */
+    Package::setcolresolver([this] (const Package *pkg) {
+        const vector<int> &groups = sortcache.groups(state.coloredby);
+        return (pkg->getindex() < groups.size()) ? groups[pkg->getindex()] : 0;
+    });
+    Package::setrootresolver([this] (const Package *pkg) {
+        return (pkg->getindex() < rootinfo.size()) ? rootinfo[pkg->getindex()] : boost::string_ref();
+    });
+
+    loader.start([this, threads] (Loader &l) {
+        loadpkgs(l, threads);
+    });
+
+    if (batch) {
+        vector<Loader::Batch> batches;
+        while (!loader.poll(batches)) {
+            EventLoop::wait(-1);
+        }
+        addpackages(batches);
+        return;
+    }
+
+    /* the ui is usable right away, packages show up as they are loaded */
+    loading = true;
 
     CursesUi::ui().enable_curses(&filteredpackages, &opqueue);
 
@@ -123,19 +239,93 @@ void Program::init(const char *conf_file)
     CursesUi::ui().update_display(state);
 }
 
+void Program::setroots(const vector<string> &roots)
+{
+    cmdroots = roots;
+}
+
+vector<string> Program::configuredroots() const
+{
+    vector<string> all = conf.getroots();
+    all.insert(all.end(), cmdroots.begin(), cmdroots.end());
+    return all;
+}
+
+bool Program::runbatch(const vector<string> &commands, BatchOutput &output)
+{
+    for (const string &cmd : commands) {
+        const FilterOperationEnum op = strtoopt(cmd.substr(0, 1));
+        if (op == OP_NONE) {
+            batcherror("unknown command: " + cmd);
+        } else {
+            state.inputbuf.set(cmd.substr(1));
+            exitinputmode(op);
+        }
+
+        if (!state.message.empty()) {
+            std::cerr << state.message << std::endl;
+            state.message.clear();
+        }
+        if (batchfailed) {
+            return false;
+        }
+    }
+
+    /* written as it is walked, the view itself is never built */
+    const boost::dynamic_bitset<> &mask = currentmask();
+    for (const Package *p : sortedpackages) {
+        if (mask[p->getindex()]) {
+            output.write(p);
+        }
+    }
+
+    return true;
+}
+
+void Program::batcherror(const string &msg)
+{
+    state.message = msg;
+    batchfailed = batch;
+}
+
 void Program::mainloop()
 {
     int ch;
     while (!quit) {
         ch = getch();
 
+        /* info of the packages around the focused one is prepared while
+           there is nothing else to do, a key press stops it */
+        while (ch == ERR && EventLoop::idle(STDIN_FILENO) && CursesUi::ui().prefetch_info()) { }
+
+        /* sleep until there is something to do, buffered keys come first */
+        if (ch == ERR && !EventLoop::wait(STDIN_FILENO)) {
+            /* the terminal is gone */
+            quit = true;
+            continue;
+        }
+
         /* If a resize has been requested, handle it. */
         CursesUi::ui().handle_resize(state);
 
+        /* packages and live filter results arrive in the background */
+        const bool loaded = pollloader();
+        const bool output = pollcommand();
+        const bool reloaded = pollwatcher();
+        if (polllivefilter() || loaded || output || reloaded) {
+            updatesearchstatus();
+            CursesUi::ui().update_display(state);
+        }
+
         if (ch == ERR || ch == KEY_RESIZE) {
             continue;
         }
 
+        const Profiler::Clock::time_point keystart = Profiler::Clock::now();
+
+        /* messages are shown until the next key press */
+        state.message.clear();
+
         if (state.mode == MODE_STANDARD) {
             switch (ch) {
             case 'k':
@@ -194,6 +384,24 @@ void Program::mainloop()
             case 'c':
                 execctrl(CTRL_FILTER_CLEAR);
                 break;
+            case 'o':
+                execctrl(CTRL_OUTPUT_TOGGLE);
+                break;
+            case 'K':
+                execctrl(CTRL_OUTPUT_UP);
+                break;
+            case 'J':
+                execctrl(CTRL_OUTPUT_DOWN);
+                break;
+            case 'u':
+                execctrl(CTRL_FILTER_POP);
+                break;
+            case '>':
+                execctrl(CTRL_SEARCH_NEXT);
+                break;
+            case '<':
+                execctrl(CTRL_SEARCH_PREV);
+                break;
             case 'n':
             case 'd':
                 prepinputmode(OP_FILTER);
@@ -204,6 +412,7 @@ void Program::mainloop()
             case '?':
             case ';':
             case '!':
+            case '&':
             case '@':
             case '%':
                 prepinputmode(strtoopt(string(1, ch)));
@@ -252,11 +461,25 @@ void Program::mainloop()
                 state.inputbuf.insert(ch);
                 break;
             }
+
+            if (state.mode == MODE_INPUT && state.op == OP_FILTER) {
+                updatelivefilter();
+            }
         } else if (state.mode == MODE_HELP) {
             /* exit help screen with any key */
             state.mode = MODE_STANDARD;
         }
 
+        updatesearchstatus();
+
+        /* the display update can't be part of it, the last one is shown */
+        if (conf.getshowlatency()) {
+            const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    Profiler::Clock::now() - keystart).count();
+            state.latency = Profiler::ms(ns) + " ms, display " +
+                            Profiler::ms(Profiler::entry("display").last) + " ms";
+        }
+
         CursesUi::ui().update_display(state);
     }
 }
@@ -273,18 +496,43 @@ void Program::prepinputmode(FilterOperationEnum o)
 void Program::exitinputmode(FilterOperationEnum o)
 {
     state.mode = MODE_STANDARD;
-    curs_set(0);
+    if (!batch) {
+        curs_set(0);
+    }
 
     state.op = OP_NONE;
 
+    /* the live filter result can be kept if it is up to date */
+    boost::dynamic_bitset<> mask;
+    const bool live = liveactive && livequery == state.inputbuf.getcontents();
+    if (live) {
+        mask.swap(livemask);
+    }
+    stoplivefilter();
+
     if (state.inputbuf.getcontents().length() == 0) {
         return;
     }
 
+    /* without a ui, only what changes the view makes sense */
+    if (batch && o != OP_FILTER && o != OP_SORT && o != OP_MACRO && o != OP_CTRL) {
+        batcherror("not available in batch mode: " + state.inputbuf.getcontents());
+        return;
+    }
+
     switch (o) {
     case OP_FILTER:
-        filterpackages(state.inputbuf.getcontents());
-        flushinp();
+        if (live) {
+            /* it has been parsed successfully before */
+            const Query query(state.inputbuf.getcontents());
+            gethis(OP_FILTER)->add(state.inputbuf.getcontents());
+            pushfilter(state.inputbuf.getcontents(), chainkey(query.normalized()), mask);
+        } else {
+            filterpackages(state.inputbuf.getcontents());
+        }
+        if (!batch) {
+            flushinp();
+        }
         break;
     case OP_SORT:
         sortpackages(state.inputbuf.getcontents());
@@ -298,6 +546,9 @@ void Program::exitinputmode(FilterOperationEnum o)
     case OP_EXEC:
         execmd(state.inputbuf.getcontents());
         break;
+    case OP_EXEC_BG:
+        execbg(state.inputbuf.getcontents());
+        break;
     case OP_MACRO:
         execmacro(state.inputbuf.getcontents());
         break;
@@ -309,19 +560,11 @@ void Program::exitinputmode(FilterOperationEnum o)
     }
 }
 
-void Program::loadpkgs()
+void Program::openhandle()
 {
-    std::cout << "Reading package dbs, please wait..." << std::endl;
-
     _alpm_errno_t err;
 
-    conf.parse_pacmanconf();
-    conf.parse_pcursesconf();
-    macros = conf.getmacros();
-
-
-    alpm_handle_t *handle =
-        alpm_initialize(conf.getrootdir().c_str(), conf.getdbpath().c_str(), &err);
+    handle = alpm_initialize(conf.getrootdir().c_str(), conf.getdbpath().c_str(), &err);
     if (handle == NULL) {
         throw PcursesException(alpm_strerror(err));
     }
@@ -333,187 +576,1253 @@ void Program::loadpkgs()
         /* i'm going to be lazy here and remind myself to handle siglevel properly later on */
         alpm_register_syncdb(handle, repo.c_str(), ALPM_SIG_USE_DEFAULT);
     }
+}
 
-    alpm_db_t *localdb = alpm_get_localdb(handle);
+alpm_pkg_t *Program::resolvelocal(boost::string_ref name)
+{
+    try {
+        if (handle == NULL) {
+            openhandle();
+        }
+    } catch (const PcursesException &) {
+        return NULL;
+    }
 
-    const auto cmp_pkg_name = [] (const Package *lhs, const Package *rhs) {
-        return Filter::cmp(lhs, rhs, A_NAME);
-    };
+    return alpm_db_get_pkg(alpm_get_localdb(handle), name.to_string().c_str());
+}
 
-    /* create our package list */
-    alpm_list_t *dbs = alpm_list_copy(alpm_get_syncdbs(handle));
-    dbs = alpm_list_add(dbs, localdb);
-    for (; dbs; dbs = alpm_list_next(dbs)) {
-        alpm_db_t *db = (alpm_db_t *)dbs->data;
-        for (alpm_list_t *pkgs = alpm_db_get_pkgcache(db); pkgs; pkgs = alpm_list_next(pkgs)) {
-            alpm_pkg_t *pkg = (alpm_pkg_t *)pkgs->data;
-            Package *p = new Package(pkg, localdb);
-            Package *parray[] = { p };
-            if (!std::includes(packages.begin(), packages.end(),
-                               parray, parray + 1, cmp_pkg_name)) {
-                packages.push_back(p);
-            } else {
-                delete p;
-            }
-        }
-        std::sort(packages.begin(), packages.end(), cmp_pkg_name);
+void Program::loadpkgs(Loader &loader, uint threads)
+{
+    /* the snapshot is only valid as long as the dbs have not changed */
+    loader.setprogress("snapshot");
+    dbstamps = Snapshot::dbstamps(conf);
+    if (conf.getsnapshot()) {
+        snapshotpath = Snapshot::path();
+        snapshotstamp = Snapshot::stamp(conf, dbstamps);
     }
-    alpm_list_free(dbs);
 
-    if (alpm_release(handle) != 0) {
-        throw PcursesException("failed to deinitialize alpm library");
+    if (snapshotpath.empty() || !snapshot.open(snapshotpath, snapshotstamp)) {
+        loadalpm(loader, threads);
+        loadroots(loader, threads);
+        return;
     }
 
+    Profiler::Span span("load snapshot");
+    Loader::Batch batch;
+    batch.source = "snapshot";
+    batch.packages.resize(snapshot.count());
+    {
+        /* nothing has been published yet, only showmemstats() waits */
+        std::lock_guard<std::mutex> lock(Package::alpmlock());
+        for (size_t i = 0; i < batch.packages.size(); i++) {
+            batch.packages[i] = snapshot.createpackage(i, *pools[0], lazypool);
+        }
+    }
+    snapshot.versionkeys(batch.versionkeys);
+    Package::setlocalresolver([this] (boost::string_ref name) {
+        return resolvelocal(name);
+    });
+
+    loader.publish(batch);
 
-    filteredpackages = packages;
+    loadroots(loader, threads);
 }
 
-void Program::clearfilter()
+void Program::loadalpm(Loader &loader, uint threads)
 {
-    filteredpackages = packages;
-    const AttributeEnum sortedby = state.sortedby;
-    std::sort(filteredpackages.begin(), filteredpackages.end(),
-              [sortedby] (const Package *lhs, const Package *rhs) {
-                  return Filter::cmp(lhs, rhs, sortedby);
-              });
+    alpm_db_t *localdb;
+    vector<alpm_db_t *> dbs;
+
+    /* the local db comes first, so that installed packages can be worked
+       with before the (much larger) sync dbs are read */
+    {
+        std::lock_guard<std::mutex> lock(Package::alpmlock());
+
+        openhandle();
+        synchandle = handle;
+        localdb = alpm_get_localdb(handle);
+        dbs.push_back(localdb);
+        for (alpm_list_t *i = alpm_get_syncdbs(handle); i; i = alpm_list_next(i)) {
+            dbs.push_back((alpm_db_t *)i->data);
+        }
+    }
 
-    state.searchphrases = "";
-    CursesUi::ui().list()->moveabs(0);
+    /* sync dbs are listed in order of priority, the first one providing a
+       package name wins. sync packages replace local ones of the same name
+       once they are added, see addpackages() */
+    std::unordered_set<string> syncnames;
+
+    /* the packages from the local db, by name. sync packages of the same
+       builds are created from them instead of being read again */
+    std::unordered_map<boost::string_ref, const Package *, StringPool::Hash> installed;
+
+    for (size_t d = 0; d < dbs.size() && !loader.cancelled(); d++) {
+        alpm_db_t *db = dbs[d];
+        Profiler::Span span(string("load ") + alpm_db_get_name(db));
+        Loader::Batch batch;
+        vector<alpm_pkg_t *> jobs;
+
+        /* libalpm is not thread safe. Everything it loads lazily (the package
+           caches and the local package descriptions) is pulled in here, so that
+           the workers below and lazy computations on published packages (which
+           only look at the local db) only ever read from it. */
+        {
+            std::lock_guard<std::mutex> lock(Package::alpmlock());
+
+            batch.source = alpm_db_get_name(db);
+            loader.setprogress(boost::str(boost::format("%s (%d/%d)")
+                                          % batch.source % (d + 1) % dbs.size()));
+
+            for (alpm_list_t *j = alpm_db_get_pkgcache(db); j; j = alpm_list_next(j)) {
+                alpm_pkg_t *pkg = (alpm_pkg_t *)j->data;
+                if (db == localdb) {
+                    alpm_pkg_get_reason(pkg);
+                    jobs.push_back(pkg);
+                } else if (syncnames.insert(alpm_pkg_get_name(pkg)).second) {
+                    jobs.push_back(pkg);
+                }
+            }
+        }
+
+        Profiler::Span construction("construct packages");
+        batch.packages.assign(jobs.size(), NULL);
+        Parallel::for_each_chunk(jobs.size(), threads, 256,
+        [this, &loader, &jobs, &batch, &installed, localdb] (size_t begin, size_t end, uint worker) {
+            const bool lazy = this->batch || conf.getlazyfields();
+            for (size_t i = begin; i < end && !loader.cancelled(); i++) {
+                const auto it = installed.find(alpm_pkg_get_name(jobs[i]));
+                batch.packages[i] = (it == installed.end()) ?
+                                    Package::create(jobs[i], localdb, *pools[worker], lazypool, lazy) :
+                                    Package::create(jobs[i], *it->second, *pools[worker], lazypool, lazy);
+            }
+        });
+
+        if (db == localdb && !loader.cancelled()) {
+            for (const Package *p : batch.packages) {
+                installed[p->getstrattr(A_NAME)] = p;
+            }
+        }
+
+        if (!loader.cancelled()) {
+            loader.publish(batch);
+        }
+    }
 }
 
-History *Program::gethis(FilterOperationEnum o)
+void Program::loadroots(Loader &loader, uint threads)
 {
-    History *v = NULL;
-
-    switch (o) {
-    case OP_FILTER:
-        v = &hisfilter;
-        break;
-    case OP_SORT:
-        v = &hissort;
-        break;
-    case OP_SEARCH:
-        v = &hissearch;
-        break;
-    case OP_COLORCODE:
-        v = &hiscolorcode;
-        break;
-    case OP_EXEC:
-        v = &hisexec;
-        break;
-    case OP_MACRO:
-        v = &hismacro;
-        break;
-    case OP_CTRL:
-        v = &hisctrl;
-        break;
-    default:
-        assert(0);
+    if (roots.empty() || loader.cancelled()) {
+        return;
     }
 
-    return v;
+    Profiler::Span span("load roots");
+    loader.setprogress(boost::str(boost::format("%d roots") % roots.size()));
+
+    Loader::Batch batch;
+    batch.source = "roots";
+    readroots(roots, threads, batch.rootversions);
+
+    if (!loader.cancelled()) {
+        loader.publish(batch);
+    }
 }
 
-ControlOperationEnum Program::parsectrl(const std::string &str) const
+void Program::readroots(const vector<string> &roots, uint threads,
+                        vector<RootVersions> &out) const
 {
-    static std::unordered_map<std::string, ControlOperationEnum> mapping({
-        { "scroll_up", CTRL_SCROLL_UP }
-        , { "scroll_down", CTRL_SCROLL_DOWN }
-        , { "scroll_home", CTRL_SCROLL_HOME }
-        , { "scroll_end", CTRL_SCROLL_END }
-        , { "scroll_pageup", CTRL_SCROLL_PAGEUP }
-        , { "scroll_pagedown", CTRL_SCROLL_PAGEDOWN }
-        , { "switch_focus", CTRL_SWITCH_FOCUS }
-        , { "queue_push", CTRL_QUEUE_PUSH }
-        , { "queue_pop", CTRL_QUEUE_POP }
-        , { "queue_clear", CTRL_QUEUE_CLEAR }
-        , { "help", CTRL_HELP }
-        , { "quit", CTRL_QUIT }
-        , { "reload", CTRL_RELOAD }
-        , { "filter_clear", CTRL_FILTER_CLEAR }
+    out.assign(roots.size(), RootVersions());
+
+    /* handles don't share any state, so each worker can use its own */
+    Parallel::for_each_chunk(roots.size(), threads, 1,
+    [&roots, &out] (size_t begin, size_t end, uint) {
+        for (size_t i = begin; i < end; i++) {
+            /* the db lives inside the root, like with pacman --root */
+            const string dbpath = roots[i] + "/var/lib/pacman";
+            _alpm_errno_t err;
+
+            alpm_handle_t *h = alpm_initialize(roots[i].c_str(), dbpath.c_str(), &err);
+            if (h == NULL) {
+                throw PcursesException(roots[i] + ": " + alpm_strerror(err));
+            }
+
+            alpm_list_t *pkgs = alpm_db_get_pkgcache(alpm_get_localdb(h));
+            out[i].reserve(alpm_list_count(pkgs));
+            for (alpm_list_t *j = pkgs; j; j = alpm_list_next(j)) {
+                alpm_pkg_t *pkg = (alpm_pkg_t *)j->data;
+                out[i][alpm_pkg_get_name(pkg)] = alpm_pkg_get_version(pkg);
+            }
+
+            alpm_release(h);
+        }
     });
+}
+
+bool Program::reloadroots(string &error)
+{
+    const vector<string> wanted = configuredroots();
+    if (wanted.empty() && roots.empty()) {
+        return false;
+    }
 
+    /* the other roots are cheap to read and have no stamps */
+    vector<RootVersions> versions;
     try {
-        return mapping[str];
-    } catch (const std::out_of_range &) {
-        return CTRL_NONE;
+        readroots(wanted, Parallel::threadcount(conf.getloadthreads()), versions);
+    } catch (const PcursesException &e) {
+        error = e.getmessage() + ", root comparison not updated";
+        return false;
     }
-}
 
-void Program::execctrl(const std::string &str)
-{
-    gethis(OP_CTRL)->add(str);
-    execctrl(parsectrl(str));
+    if (wanted == roots && versions == rootversions) {
+        return false;
+    }
+
+    roots = wanted;
+    rootversions.swap(versions);
+    return true;
 }
 
-void Program::execctrl(const ControlOperationEnum op)
+void Program::updaterootinfo()
 {
-    switch (op) {
-    case CTRL_SCROLL_UP:
-        CursesUi::ui().focused()->move(-1);
-        break;
-    case CTRL_SCROLL_DOWN:
-        CursesUi::ui().focused()->move(1);
-        break;
-    case CTRL_SCROLL_HOME:
-        CursesUi::ui().focused()->moveabs(0);
-        break;
-    case CTRL_SCROLL_END:
-        CursesUi::ui().focused()->movetoend();
-        break;
-    case CTRL_SCROLL_PAGEUP:
-        CursesUi::ui().focused()->move(CursesUi::ui().list()->usableheight() * -1);
-        break;
-    case CTRL_SCROLL_PAGEDOWN:
-        CursesUi::ui().focused()->move(CursesUi::ui().list()->usableheight());
-        break;
-    case CTRL_SWITCH_FOCUS:
-        CursesUi::ui().switch_focus();
-        break;
-    case CTRL_QUEUE_PUSH:
-        if (CursesUi::ui().focused() != CursesUi::ui().list()) {
-            break;
+    const auto cmp_pkg_name = [] (const Package *lhs, const Package *rhs) {
+        return Filter::cmp(lhs, rhs, A_NAME);
+    };
+    const auto findname = [this] (const string &name) {
+        return std::lower_bound(packages.begin(), packages.end(), name,
+        [] (const Package *p, const string &s) {
+            return p->getstrattr(A_NAME) < s;
+        });
+    };
+
+    /* placeholders are created again, queued ones are looked up by name
+       once they are */
+    std::unordered_map<const Package *, string> queuedrootonly;
+    for (const Package *p : opqueue) {
+        if (rootonly.count(p) != 0) {
+            queuedrootonly[p] = p->getname();
         }
-        if (filteredpackages.size() == 0) {
-            break;
+    }
+    droprootonly();
+    rootonly.clear();
+
+    /* the info pane caches the comparison, and new placeholders may take
+       the place of old ones in memory */
+    if (!batch && (!rootinfo.empty() || !rootversions.empty())) {
+        CursesUi::ui().invalidate();
+    }
+    rootinfo.clear();
+    rootdiffmask.clear();
+    rootpool.release();
+
+    /* packages only installed in other roots (foreign ones, or from repos
+       rootdir doesn't use) get a placeholder, so that they show up in the
+       comparison. its version is the one of the first root having it. */
+    std::map<string, boost::string_ref> missing;
+    for (const RootVersions &versions : rootversions) {
+        for (const auto &entry : versions) {
+            vector<Package *>::const_iterator it = findname(entry.first);
+            if (it == packages.end() || (*it)->getstrattr(A_NAME) != entry.first) {
+                missing.insert(std::make_pair(entry.first, boost::string_ref(entry.second)));
+            }
         }
+    }
 
-        if (std::find(opqueue.begin(), opqueue.end(),
-                      filteredpackages[CursesUi::ui().list()->focusedindex()]) != opqueue.end()) {
-            break;
+    if (!missing.empty()) {
+        Package::Fields fields;
+        const boost::string_ref empty = rootpool.store("");
+        fields.url = fields.packager = fields.desc = fields.arch = fields.licenses =
+            fields.groups = fields.localversion = fields.ldesc = fields.depends =
+            fields.builddatestr = fields.optdepends = fields.conflicts = fields.provides =
+            fields.replaces = empty;
+        fields.dbname = rootpool.intern("roots");
+        fields.sizestr = fields.installsizestr = rootpool.intern(Package::size2str(0));
+        fields.signature = Package::signaturetostr(false);
+        fields.size = fields.installsize = fields.builddate = 0;
+        fields.updatestate = USE_NOTINSTALLED;
+        fields.reason = IRE_NOTINSTALLED;
+
+        vector<Package *> added;
+        for (const auto &m : missing) {
+            fields.name = rootpool.store(m.first);
+            fields.lname = rootpool.lower(fields.name);
+            fields.version = fields.versionstr = rootpool.store(m.second);
+            added.push_back(Package::create(fields, rootpool, rootpool));
+            rootonly.insert(added.back());
         }
-        opqueue.push_back(filteredpackages[CursesUi::ui().list()->focusedindex()]);
-        CursesUi::ui().queue()->movetoend();
-        CursesUi::ui().focused()->move(1);
-        break;
-    case CTRL_QUEUE_POP:
-        if (CursesUi::ui().focused() != CursesUi::ui().queue()) {
-            break;
+
+        const size_t mid = packages.size();
+        packages.insert(packages.end(), added.begin(), added.end());
+        std::inplace_merge(packages.begin(), packages.begin() + mid, packages.end(), cmp_pkg_name);
+    }
+
+    if (!queuedrootonly.empty()) {
+        vector<Package *> queue;
+        for (Package *p : opqueue) {
+            const auto q = queuedrootonly.find(p);
+            if (q == queuedrootonly.end()) {
+                queue.push_back(p);
+                continue;
+            }
+            vector<Package *>::const_iterator it = findname(q->second);
+            if (it != packages.end() && (*it)->getstrattr(A_NAME) == q->second) {
+                queue.push_back(*it);
+            }
         }
-        CursesUi::ui().queue()->removeselected();
-        if (opqueue.empty()) {
-            CursesUi::ui().set_focus(PANE_LIST);
+        if (!batch && queue.size() != opqueue.size()) {
+            CursesUi::ui().queue()->moveabs(0);
         }
-        break;
-    case CTRL_QUEUE_CLEAR:
-        while (!opqueue.empty()) {
-            CursesUi::ui().queue()->removeselected();
+        opqueue.swap(queue);
+    }
+
+    for (uint i = 0; i < packages.size(); i++) {
+        packages[i]->setindex(i);
+    }
+    rebuildqueuemask();
+
+    if (rootversions.empty()) {
+        return;
+    }
+
+    /* version installed in each root, root 0 being rootdir. only the
+       installed packages of each root are looked up */
+    const size_t n = rootversions.size() + 1;
+    vector<boost::string_ref> versions(packages.size() * n);
+    boost::dynamic_bitset<> installed(packages.size());
+
+    for (size_t i = 0; i < packages.size(); i++) {
+        versions[i * n] = packages[i]->getlocalversion();
+        if (!versions[i * n].empty()) {
+            installed.set(i);
         }
-        CursesUi::ui().set_focus(PANE_LIST);
-        break;
-    case CTRL_HELP:
-        state.mode = MODE_HELP;
-        break;
+    }
+
+    for (size_t r = 0; r < rootversions.size(); r++) {
+        for (const auto &entry : rootversions[r]) {
+            vector<Package *>::const_iterator it = findname(entry.first);
+            if (it != packages.end() && (*it)->getstrattr(A_NAME) == entry.first) {
+                versions[(it - packages.begin()) * n + r + 1] = entry.second;
+                installed.set(it - packages.begin());
+            }
+        }
+    }
+
+    rootinfo.resize(packages.size());
+    rootdiffmask.resize(packages.size());
+
+    string info;
+    for (size_t i = installed.find_first(); i < packages.size(); i = installed.find_next(i)) {
+        /* placeholders have no sync version to compare with */
+        const bool hassync = rootonly.count(packages[i]) == 0;
+        const string sync = packages[i]->getrawversion().to_string();
+
+        info.clear();
+        for (size_t r = 0; r < n; r++) {
+            const boost::string_ref v = versions[i * n + r];
+
+            if (r != 0) {
+                info += ", ";
+            }
+            info += (r == 0) ? conf.getrootdir() : roots[r - 1];
+            info += ": ";
+            if (v.empty()) {
+                info += "-";
+            } else {
+                info.append(v.data(), v.length());
+                if (hassync && alpm_pkg_vercmp(sync.c_str(), v.to_string().c_str()) > 0) {
+                    info += " (outdated)";
+                }
+            }
+
+            if (v != versions[i * n]) {
+                rootdiffmask.set(i);
+            }
+        }
+
+        rootinfo[i] = rootpool.store(info);
+    }
+}
+
+void Program::droprootonly()
+{
+    if (rootonly.empty()) {
+        return;
+    }
+
+    packages.erase(std::remove_if(packages.begin(), packages.end(), [this] (const Package *p) {
+        return rootonly.count(p) != 0;
+    }), packages.end());
+}
+
+bool Program::pollloader()
+{
+    bool changed = false;
+
+    if (loading) {
+        vector<Loader::Batch> batches;
+        const bool finished = loader.poll(batches);
+
+        if (!batches.empty()) {
+            addpackages(batches);
+            changed = true;
+        }
+
+        const string progress = finished ? "" : loader.getprogress();
+        if (progress != state.progress) {
+            state.progress = progress;
+            changed = true;
+        }
+
+        if (finished) {
+            loading = false;
+            if (!snapshot.isopen()) {
+                startsnapshotwriter();
+            }
+            if (conf.getautoreload() && !batch) {
+                try {
+                    watcher.start(conf);
+                } catch (const PcursesException &e) {
+                    state.message = e.getmessage();
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /* don't interfere with input in progress */
+    if (!loading && startuppending && state.mode == MODE_STANDARD) {
+        startuppending = false;
+        execmacro("startup");
+        changed = true;
+    }
+
+    return changed;
+}
+
+bool Program::pollwatcher()
+{
+    /* like the startup macro, changes wait for input in progress */
+    if (loading || state.mode != MODE_STANDARD) {
+        return false;
+    }
+
+    Snapshot::Stamps stamps;
+    if (!watcher.poll(stamps) || stamps == dbstamps) {
+        return false;
+    }
+
+    reloaddbs(stamps);
+    return true;
+}
+
+void Program::startsnapshotwriter()
+{
+    if (snapshotpath.empty()) {
+        return;
+    }
+
+    /* computing all fields takes a while, don't hold up anything for it.
+       placeholders for other roots are not saved. */
+    vector<Package *> pkgs;
+    std::remove_copy_if(packages.begin(), packages.end(), std::back_inserter(pkgs),
+    [this] (const Package *p) {
+        return rootonly.count(p) != 0;
+    });
+    const string path = snapshotpath,
+                 stamp = snapshotstamp;
+    writercancelled = false;
+    snapshotwriter = std::thread([this, pkgs, path, stamp] () {
+        try {
+            Snapshot::write(path, stamp, pkgs, writercancelled);
+        } catch (...) {
+            /* there will be another chance on the next start */
+        }
+    });
+}
+
+void Program::stopsnapshotwriter()
+{
+    if (snapshotwriter.joinable()) {
+        writercancelled = true;
+        snapshotwriter.join();
+    }
+}
+
+void Program::addpackages(vector<Loader::Batch> &batches)
+{
+    /* the live filter works on packages, it is restarted on the new ones */
+    const bool live = state.mode == MODE_INPUT && state.op == OP_FILTER;
+    stoplivefilter();
+
+    const Package *focused = batch ? NULL : CursesUi::ui().list()->focusedpackage();
+
+    const auto cmp_pkg_name = [] (const Package *lhs, const Package *rhs) {
+        return Filter::cmp(lhs, rhs, A_NAME);
+    };
+
+    vector<int64_t> versionkeys;
+    for (Loader::Batch &batch : batches) {
+        if (!batch.rootversions.empty()) {
+            rootversions.swap(batch.rootversions);
+        }
+
+        /* the keys were computed on exactly this batch */
+        if (packages.empty()) {
+            versionkeys.swap(batch.versionkeys);
+        } else {
+            versionkeys.clear();
+        }
+
+        /* names are unique, so the order does not depend on the thread count */
+        std::sort(batch.packages.begin(), batch.packages.end(), cmp_pkg_name);
+
+        vector<Package *> added;
+        for (Package *p : batch.packages) {
+            vector<Package *>::iterator it =
+                std::lower_bound(packages.begin(), packages.end(), p, cmp_pkg_name);
+            if (it == packages.end() || cmp_pkg_name(p, *it)) {
+                added.push_back(p);
+                continue;
+            }
+
+            /* the sync package takes the place of the local one. the local
+               one stays valid until its pool is released, only its strings
+               may live on in p */
+            deadbytes += p->sharesstrings(**it) ? sizeof(Package) : (*it)->poolbytes();
+            std::replace(opqueue.begin(), opqueue.end(), *it, p);
+            if (focused == *it) {
+                focused = p;
+            }
+            *it = p;
+        }
+
+        const size_t mid = packages.size();
+        packages.insert(packages.end(), added.begin(), added.end());
+        std::inplace_merge(packages.begin(), packages.begin() + mid, packages.end(), cmp_pkg_name);
+    }
+
+    /* sets the indices */
+    updaterootinfo();
+
+    allmask.clear();
+    searchindex.clear();
+    depgraph.clear();
+    filtercache.invalidate();
+    sortcache.reset(packages);
+    if (!versionkeys.empty() && versionkeys.size() == packages.size()) {
+        sortcache.setkeys(A_VERSION, versionkeys);
+    }
+    reapplyfilters();
+    colorcodepackages(state.coloredby);
+    sortall();
+    updateview();
+
+    if (batch) {
+        return;
+    }
+
+    /* stay on the focused package */
+    vector<Package *>::const_iterator it =
+        std::find(filteredpackages.begin(), filteredpackages.end(), focused);
+    CursesUi::ui().list()->moveabs((it == filteredpackages.end()) ?
+                                   0 : it - filteredpackages.begin());
+
+    if (live) {
+        updatelivefilter();
+    }
+}
+
+void Program::reapplyfilters()
+{
+    boost::dynamic_bitset<> base(packages.size());
+    base.set();
+
+    for (FilterLayer &layer : filters) {
+        if (layer.graphop != CTRL_NONE) {
+            layer.mask.resize(packages.size());
+            layer.mask.reset();
+            graphselect(layer.graphop, layer.seeds, layer.mask);
+            layer.mask &= base;
+            base = layer.mask;
+            filtercache.insertmask(layer.chain, layer.mask);
+            continue;
+        }
+
+        /* it has been parsed successfully before */
+        const Query query(layer.query);
+
+        buildsearchindex(query);
+
+        layer.mask.resize(packages.size());
+        layer.mask.reset();
+        query.select(packages, base, &searchindex, workers(base.count()), layer.mask);
+        base = layer.mask;
+        filtercache.insertmask(layer.chain, layer.mask);
+    }
+}
+
+/* local db entries are named <name>-<pkgver>-<pkgrel> */
+static string localentryname(const string &entry)
+{
+    const size_t rel = entry.rfind('-');
+    if (rel == string::npos || rel == 0) {
+        return entry;
+    }
+    const size_t ver = entry.rfind('-', rel - 1);
+    return (ver == string::npos) ? entry : entry.substr(0, ver);
+}
+
+void Program::reload()
+{
+    Profiler::Span span("reload");
+
+    /* a list which is not complete yet can't be patched */
+    if (loading) {
+        execctrl(CTRL_RELOAD_FULL);
+        return;
+    }
+
+    const vector<string> repos = conf.getrepos();
+    const string rootdir = conf.getrootdir(),
+                 dbpath = conf.getdbpath();
+
+    conf.parse_pacmanconf();
+    conf.parse_pcursesconf();
+    macros = conf.getmacros();
+
+    if (conf.getrepos() != repos || conf.getrootdir() != rootdir || conf.getdbpath() != dbpath) {
+        execctrl(CTRL_RELOAD_FULL);
+        return;
+    }
+
+    reloaddbs(Snapshot::dbstamps(conf));
+}
+
+void Program::reloaddbs(const Snapshot::Stamps &stamps)
+{
+    string rooterror;
+    const bool rootschanged = reloadroots(rooterror);
+    const auto report = [this, &rooterror] (const string &msg) {
+        state.message = rooterror.empty() ? msg : msg + "; " + rooterror;
+    };
+
+    /* find out what has changed since loading */
+    std::unordered_set<string> changedrepos,
+        changednames;
+    const auto compare = [&] (const Snapshot::Stamps &a, const Snapshot::Stamps &b) {
+        for (const auto &st : a) {
+            const Snapshot::Stamps::const_iterator it = b.find(st.first);
+            if (it != b.end() && it->second == st.second) {
+                continue;
+            }
+            if (boost::starts_with(st.first, "local/")) {
+                changednames.insert(localentryname(st.first.substr(strlen("local/"))));
+            } else if (st.first != "local") {
+                changedrepos.insert(st.first);
+            }
+        }
+    };
+    compare(dbstamps, stamps);
+    compare(stamps, dbstamps);
+
+    if (changedrepos.empty() && changednames.empty()) {
+        dbstamps = stamps;
+
+        if (rootschanged) {
+            stoplivefilter();
+            const Package *focused = CursesUi::ui().list()->focusedpackage();
+            const string focusedname = (focused == NULL) ? "" : focused->getname();
+
+            updaterootinfo();
+            refreshpackages(focusedname);
+            report("package dbs are unchanged, root comparison updated");
+        } else {
+            report("package dbs are unchanged");
+        }
+        return;
+    }
+
+    /* replaced packages stay in their pools. once they take up half of
+       them, starting over is cheaper than carrying them along */
+    size_t poolbytes = 0;
+    for (const StringPool *pool : pools) {
+        poolbytes += pool->getstats().blockbytes;
+    }
+    if (deadbytes * 2 > poolbytes) {
+        execctrl(CTRL_RELOAD_FULL);
+        return;
+    }
+
+    /* nothing else may look at packages while they are patched */
+    stoplivefilter();
+    stopsnapshotwriter();
+
+    const Package *focused = CursesUi::ui().list()->focusedpackage();
+    const string focusedname = (focused == NULL) ? "" : focused->getname();
+
+    /* placeholders aren't patched, they are created again with the
+       comparison */
+    droprootonly();
+
+    std::unordered_map<boost::string_ref, Package *, StringPool::Hash> byname;
+    for (Package *p : packages) {
+        byname[p->getstrattr(A_NAME)] = p;
+    }
+    const auto lookup = [&byname] (const char *name) -> Package * {
+        const auto it = byname.find(name);
+        return (it == byname.end()) ? NULL : it->second;
+    };
+    const auto islocal = [] (const Package *p) {
+        return p->getstrattr(A_REPO) == "local";
+    };
+
+    vector<Package *> result;
+    /* kept packages whose local package has changed, and the libalpm and
+       local packages of all kept packages in the new handle. both are
+       applied once the lock is released. */
+    vector<std::pair<Package *, alpm_pkg_t *> > relocal;
+    struct Rebase {
+        Package *p;
+        alpm_pkg_t *pkg,
+                   *localpkg;
+    };
+    vector<Rebase> rebase;
+    size_t created = 0;
+    /* the handles packages point into until they are rebased */
+    alpm_handle_t *const oldhandle = handle,
+                  *const oldsynchandle = synchandle;
+    {
+        std::lock_guard<std::mutex> lock(Package::alpmlock());
+
+        /* a new handle sees the changes */
+        handle = NULL;
+        try {
+            openhandle();
+        } catch (...) {
+            handle = oldhandle;
+            throw;
+        }
+
+        const auto create = [&] (alpm_pkg_t *pkg, alpm_db_t *localdb) {
+            result.push_back(Package::create(pkg, localdb, *pools[0], lazypool,
+                                             conf.getlazyfields()));
+            created++;
+        };
+
+        alpm_db_t *localdb = alpm_get_localdb(handle);
+        for (alpm_list_t *i = alpm_db_get_pkgcache(localdb); i; i = alpm_list_next(i)) {
+            alpm_pkg_get_reason((alpm_pkg_t *)i->data);
+        }
+
+        if (!changedrepos.empty()) {
+            /* the same selection as when loading, but packages of unchanged
+               dbs are kept */
+            std::unordered_set<string> syncnames;
+            for (alpm_list_t *i = alpm_get_syncdbs(handle); i; i = alpm_list_next(i)) {
+                alpm_db_t *db = (alpm_db_t *)i->data;
+                const string dbname = alpm_db_get_name(db);
+                const bool unchanged = changedrepos.count(dbname) == 0;
+
+                for (alpm_list_t *j = alpm_db_get_pkgcache(db); j; j = alpm_list_next(j)) {
+                    alpm_pkg_t *pkg = (alpm_pkg_t *)j->data;
+                    const char *name = alpm_pkg_get_name(pkg);
+                    if (!syncnames.insert(name).second) {
+                        continue;
+                    }
+
+                    Package *old = lookup(name);
+                    if (old == NULL || !unchanged || old->getstrattr(A_REPO) != dbname) {
+                        create(pkg, localdb);
+                        continue;
+                    }
+                    alpm_pkg_t *localpkg = alpm_db_get_pkg(localdb, name);
+                    if (changednames.count(name) != 0) {
+                        relocal.push_back(std::make_pair(old, localpkg));
+                    }
+                    rebase.push_back({ old, pkg, localpkg });
+                    result.push_back(old);
+                }
+            }
+
+            for (alpm_list_t *i = alpm_db_get_pkgcache(localdb); i; i = alpm_list_next(i)) {
+                alpm_pkg_t *pkg = (alpm_pkg_t *)i->data;
+                const char *name = alpm_pkg_get_name(pkg);
+                if (syncnames.count(name) != 0) {
+                    continue;
+                }
+
+                Package *old = lookup(name);
+                if (old != NULL && islocal(old) && changednames.count(name) == 0) {
+                    rebase.push_back({ old, pkg, pkg });
+                    result.push_back(old);
+                } else {
+                    create(pkg, localdb);
+                }
+            }
+        } else {
+            /* only installed packages have changed. sync packages stay, with
+               their local state updated. their sync data stays where it is,
+               so that the new handle doesn't have to read the sync dbs */
+            for (Package *p : packages) {
+                const string name = p->getname();
+                alpm_pkg_t *localpkg = alpm_db_get_pkg(localdb, name.c_str());
+                if (!islocal(p)) {
+                    if (changednames.count(name) != 0) {
+                        relocal.push_back(std::make_pair(p, localpkg));
+                    }
+                    rebase.push_back({ p, NULL, localpkg });
+                    result.push_back(p);
+                } else if (changednames.count(name) == 0) {
+                    rebase.push_back({ p, localpkg, localpkg });
+                    result.push_back(p);
+                }
+            }
+
+            /* packages which are only installed locally are created again */
+            for (const string &name : changednames) {
+                const Package *old = lookup(name.c_str());
+                alpm_pkg_t *pkg = alpm_db_get_pkg(localdb, name.c_str());
+                if ((old == NULL || islocal(old)) && pkg != NULL) {
+                    create(pkg, localdb);
+                }
+            }
+        }
+    }
+
+    for (const Rebase &r : rebase) {
+        r.p->rebase(r.pkg, r.localpkg);
+    }
+    for (const auto &r : relocal) {
+        r.first->setlocal(r.second);
+    }
+    Package::setlocalresolver([this] (boost::string_ref name) {
+        return resolvelocal(name);
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(Package::alpmlock());
+
+        /* if only the local db has changed, sync packages still point into
+           the handle they were loaded with. everything else has moved to
+           the new one. */
+        if (!changedrepos.empty()) {
+            synchandle = handle;
+        }
+
+        int ret = 0;
+        if (oldhandle != NULL && oldhandle != synchandle) {
+            ret |= alpm_release(oldhandle);
+        }
+        if (oldsynchandle != NULL && oldsynchandle != synchandle && oldsynchandle != oldhandle) {
+            ret |= alpm_release(oldsynchandle);
+        }
+        if (ret != 0) {
+            throw PcursesException("failed to deinitialize alpm library");
+        }
+    }
+
+    /* replaced packages stay in their pools, see above */
+    std::unordered_set<const Package *> kept(result.begin(), result.end());
+    for (const auto &entry : byname) {
+        if (kept.count(entry.second) == 0) {
+            deadbytes += entry.second->poolbytes();
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [] (const Package *lhs, const Package *rhs) {
+        return Filter::cmp(lhs, rhs, A_NAME);
+    });
+    for (uint i = 0; i < result.size(); i++) {
+        result[i]->setindex(i);
+    }
+
+    /* queued packages are looked up by name, they may have been replaced */
+    std::unordered_map<boost::string_ref, Package *, StringPool::Hash> newbyname;
+    for (Package *p : result) {
+        newbyname[p->getstrattr(A_NAME)] = p;
+    }
+    vector<Package *> queue;
+    for (Package *p : opqueue) {
+        const auto it = newbyname.find(p->getstrattr(A_NAME));
+        if (it != newbyname.end()) {
+            queue.push_back(it->second);
+        } else if (rootonly.count(p) != 0) {
+            /* see updaterootinfo() */
+            queue.push_back(p);
+        }
+    }
+    if (queue.size() != opqueue.size()) {
+        CursesUi::ui().queue()->moveabs(0);
+    }
+    opqueue.swap(queue);
+    if (opqueue.empty()) {
+        CursesUi::ui().set_focus(PANE_LIST);
+    }
+
+    packages.swap(result);
+    rebuildqueuemask();
+    dbstamps = stamps;
+    updaterootinfo();
+    refreshpackages(focusedname);
+
+    report(boost::str(boost::format("%d of %d packages updated")
+                      % (created + relocal.size()) % packages.size()));
+
+    if (!snapshotpath.empty()) {
+        snapshotstamp = Snapshot::stamp(conf, dbstamps);
+        startsnapshotwriter();
+    }
+}
+
+void Program::refreshpackages(const string &focusedname)
+{
+    allmask.clear();
+    searchindex.clear();
+    depgraph.clear();
+    filtercache.invalidate();
+    sortcache.reset(packages);
+    reapplyfilters();
+    colorcodepackages(state.coloredby);
+    sortall();
+    updateview();
+
+    /* stay on the focused package */
+    vector<Package *>::const_iterator it = std::find_if(filteredpackages.begin(),
+    filteredpackages.end(), [&focusedname] (const Package *p) {
+        return p->getstrattr(A_NAME) == focusedname;
+    });
+    CursesUi::ui().list()->moveabs((it == filteredpackages.end()) ?
+                                   0 : it - filteredpackages.begin());
+
+    /* kept packages may have been changed in place */
+    CursesUi::ui().invalidate();
+}
+
+void Program::clearfilter()
+{
+    filters.clear();
+    updateview();
+
+    if (!batch) {
+        CursesUi::ui().list()->moveabs(0);
+    }
+}
+
+void Program::popfilter()
+{
+    if (filters.empty()) {
+        return;
+    }
+
+    if (batch) {
+        filters.pop_back();
+        updateview();
+        return;
+    }
+
+    /* stay on the focused package, it is still part of the view */
+    const Package *focused = CursesUi::ui().list()->focusedpackage();
+
+    filters.pop_back();
+    updateview();
+
+    vector<Package *>::const_iterator it =
+        std::find(filteredpackages.begin(), filteredpackages.end(), focused);
+    CursesUi::ui().list()->moveabs((it == filteredpackages.end()) ?
+                                   0 : it - filteredpackages.begin());
+}
+
+const boost::dynamic_bitset<> &Program::currentmask()
+{
+    if (filters.empty()) {
+        /* everything passes an empty filter chain */
+        if (allmask.size() != packages.size()) {
+            allmask.resize(packages.size());
+            allmask.set();
+        }
+        return allmask;
+    }
+
+    return filters.back().mask;
+}
+
+uint Program::workers(size_t n) const
+{
+    return (n >= conf.getparallelthreshold()) ?
+           Parallel::threadcount(conf.getloadthreads()) : 1;
+}
+
+void Program::sortall()
+{
+    /* packages with equal keys stay sorted by name */
+    sortedpackages = sortcache.sorted(state.sortedby);
+}
+
+void Program::updateview()
+{
+    const auto build = [this] (const boost::dynamic_bitset<> &mask) {
+        filteredpackages.clear();
+        filteredpackages.reserve(mask.count());
+        for (Package *p : sortedpackages) {
+            if (mask[p->getindex()]) {
+                filteredpackages.push_back(p);
+            }
+        }
+    };
+
+    if (batch) {
+        /* the view is never built, see runbatch() */
+    } else if (liveactive) {
+        build(livemask);
+    } else if (filters.empty()) {
+        filteredpackages = sortedpackages;
+    } else {
+        const FilterLayer &layer = filters.back();
+        const vector<Package *> *cached = filtercache.findview(layer.chain, state.sortedby);
+        if (cached != NULL) {
+            filteredpackages = *cached;
+        } else {
+            build(layer.mask);
+            filtercache.insertview(layer.chain, state.sortedby, filteredpackages);
+        }
+    }
+
+    searchstale = true;
+
+    state.searchphrases.clear();
+    for (const FilterLayer &layer : filters) {
+        if (state.searchphrases.length() != 0) {
+            state.searchphrases += ", ";
+        }
+        state.searchphrases += layer.query;
+    }
+}
+
+History *Program::gethis(FilterOperationEnum o)
+{
+    History *v = NULL;
+
+    switch (o) {
+    case OP_FILTER:
+        v = &hisfilter;
+        break;
+    case OP_SORT:
+        v = &hissort;
+        break;
+    case OP_SEARCH:
+        v = &hissearch;
+        break;
+    case OP_COLORCODE:
+        v = &hiscolorcode;
+        break;
+    case OP_EXEC:
+    case OP_EXEC_BG:
+        v = &hisexec;
+        break;
+    case OP_MACRO:
+        v = &hismacro;
+        break;
+    case OP_CTRL:
+        v = &hisctrl;
+        break;
+    default:
+        assert(0);
+    }
+
+    return v;
+}
+
+ControlOperationEnum Program::parsectrl(const std::string &str) const
+{
+    static std::unordered_map<std::string, ControlOperationEnum> mapping({
+        { "scroll_up", CTRL_SCROLL_UP }
+        , { "scroll_down", CTRL_SCROLL_DOWN }
+        , { "scroll_home", CTRL_SCROLL_HOME }
+        , { "scroll_end", CTRL_SCROLL_END }
+        , { "scroll_pageup", CTRL_SCROLL_PAGEUP }
+        , { "scroll_pagedown", CTRL_SCROLL_PAGEDOWN }
+        , { "switch_focus", CTRL_SWITCH_FOCUS }
+        , { "queue_push", CTRL_QUEUE_PUSH }
+        , { "queue_pop", CTRL_QUEUE_POP }
+        , { "queue_clear", CTRL_QUEUE_CLEAR }
+        , { "queue_push_filtered", CTRL_QUEUE_PUSH_FILTERED }
+        , { "queue_pop_filtered", CTRL_QUEUE_POP_FILTERED }
+        , { "queue_invert", CTRL_QUEUE_INVERT }
+        , { "help", CTRL_HELP }
+        , { "quit", CTRL_QUIT }
+        , { "reload", CTRL_RELOAD }
+        , { "reload_full", CTRL_RELOAD_FULL }
+        , { "filter_clear", CTRL_FILTER_CLEAR }
+        , { "filter_pop", CTRL_FILTER_POP }
+        , { "filter_deps", CTRL_FILTER_DEPS }
+        , { "filter_rdeps", CTRL_FILTER_RDEPS }
+        , { "filter_orphans", CTRL_FILTER_ORPHANS }
+        , { "filter_rootdiff", CTRL_FILTER_ROOTDIFF }
+        , { "search_next", CTRL_SEARCH_NEXT }
+        , { "search_prev", CTRL_SEARCH_PREV }
+        , { "mem_stats", CTRL_MEM_STATS }
+        , { "stats", CTRL_STATS }
+        , { "output_toggle", CTRL_OUTPUT_TOGGLE }
+        , { "output_up", CTRL_OUTPUT_UP }
+        , { "output_down", CTRL_OUTPUT_DOWN }
+        , { "exec_kill", CTRL_EXEC_KILL }
+    });
+
+    try {
+        return mapping[str];
+    } catch (const std::out_of_range &) {
+        return CTRL_NONE;
+    }
+}
+
+void Program::execctrl(const std::string &str)
+{
+    gethis(OP_CTRL)->add(str);
+
+    const ControlOperationEnum op = parsectrl(str);
+    if (batch) {
+        switch (op) {
+        case CTRL_QUEUE_CLEAR:
+        case CTRL_QUEUE_PUSH_FILTERED:
+        case CTRL_QUEUE_POP_FILTERED:
+        case CTRL_QUEUE_INVERT:
+        case CTRL_FILTER_CLEAR:
+        case CTRL_FILTER_POP:
+        case CTRL_FILTER_DEPS:
+        case CTRL_FILTER_RDEPS:
+        case CTRL_FILTER_ORPHANS:
+        case CTRL_FILTER_ROOTDIFF:
+            break;
+        case CTRL_NONE:
+            batcherror("unknown control command: " + str);
+            return;
+        default:
+            batcherror("not available in batch mode: %" + str);
+            return;
+        }
+    }
+
+    execctrl(op);
+}
+
+void Program::execctrl(const ControlOperationEnum op)
+{
+    switch (op) {
+    case CTRL_SCROLL_UP:
+        CursesUi::ui().focused()->move(-1);
+        break;
+    case CTRL_SCROLL_DOWN:
+        CursesUi::ui().focused()->move(1);
+        break;
+    case CTRL_SCROLL_HOME:
+        CursesUi::ui().focused()->moveabs(0);
+        break;
+    case CTRL_SCROLL_END:
+        CursesUi::ui().focused()->movetoend();
+        break;
+    case CTRL_SCROLL_PAGEUP:
+        CursesUi::ui().focused()->move(CursesUi::ui().list()->usableheight() * -1);
+        break;
+    case CTRL_SCROLL_PAGEDOWN:
+        CursesUi::ui().focused()->move(CursesUi::ui().list()->usableheight());
+        break;
+    case CTRL_SWITCH_FOCUS:
+        CursesUi::ui().switch_focus();
+        break;
+    case CTRL_QUEUE_PUSH:
+        if (CursesUi::ui().focused() != CursesUi::ui().list()) {
+            break;
+        }
+        if (filteredpackages.size() == 0) {
+            break;
+        }
+
+        if (isqueued(filteredpackages[CursesUi::ui().list()->focusedindex()])) {
+            break;
+        }
+        opqueue.push_back(filteredpackages[CursesUi::ui().list()->focusedindex()]);
+        queuedmask.set(opqueue.back()->getindex());
+        CursesUi::ui().queue()->movetoend();
+        CursesUi::ui().focused()->move(1);
+        break;
+    case CTRL_QUEUE_POP:
+        if (CursesUi::ui().focused() != CursesUi::ui().queue()) {
+            break;
+        }
+        if (CursesUi::ui().queue()->focusedpackage() == NULL) {
+            break;
+        }
+        queuedmask.reset(CursesUi::ui().queue()->focusedpackage()->getindex());
+        CursesUi::ui().queue()->removeselected();
+        if (opqueue.empty()) {
+            CursesUi::ui().set_focus(PANE_LIST);
+        }
+        break;
+    case CTRL_QUEUE_CLEAR:
+        opqueue.clear();
+        queuedmask.reset();
+        if (!batch) {
+            CursesUi::ui().queue()->updatefocus();
+            CursesUi::ui().set_focus(PANE_LIST);
+        }
+        break;
+    case CTRL_QUEUE_PUSH_FILTERED:
+    case CTRL_QUEUE_POP_FILTERED:
+    case CTRL_QUEUE_INVERT:
+        queuefiltered(op);
+        break;
+    case CTRL_HELP:
+        state.mode = MODE_HELP;
+        break;
     case CTRL_QUIT:
         quit = true;
         break;
     case CTRL_RELOAD:
+        reload();
+        break;
+    case CTRL_RELOAD_FULL:
         deinit();
         init();
         break;
     case CTRL_FILTER_CLEAR:
         clearfilter();
         break;
+    case CTRL_FILTER_POP:
+        popfilter();
+        break;
+    case CTRL_FILTER_DEPS:
+    case CTRL_FILTER_RDEPS:
+    case CTRL_FILTER_ORPHANS:
+    case CTRL_FILTER_ROOTDIFF:
+        filtergraph(op);
+        break;
+    case CTRL_SEARCH_NEXT:
+        searchstep(1);
+        break;
+    case CTRL_SEARCH_PREV:
+        searchstep(-1);
+        break;
+    case CTRL_MEM_STATS:
+        showmemstats();
+        break;
+    case CTRL_STATS:
+        showstats();
+        break;
+    case CTRL_OUTPUT_TOGGLE:
+        state.showoutput = !state.showoutput;
+        break;
+    case CTRL_OUTPUT_UP:
+        scrolloutput(1);
+        break;
+    case CTRL_OUTPUT_DOWN:
+        scrolloutput(-1);
+        break;
+    case CTRL_EXEC_KILL:
+        if (command.busy()) {
+            command.cancel();
+            state.outputstatus = "killed";
+            state.outputversion++;
+        }
+        break;
     case CTRL_NONE:
         return; /* No error handling possible. */
     default:
@@ -523,6 +1832,8 @@ void Program::execctrl(const ControlOperationEnum op)
 
 void Program::execmacro(const string &str)
 {
+    Profiler::Span span("macro");
+
     gethis(OP_MACRO)->add(str);
 
     /* macro delimiter is ',' */
@@ -537,6 +1848,7 @@ void Program::execmacro(const string &str)
         it = macros.find(macropart);
 
         if (it == macros.end()) {
+            batcherror("unknown macro: " + macropart);
             return;
         }
 
@@ -544,6 +1856,7 @@ void Program::execmacro(const string &str)
 
         FilterOperationEnum op = strtoopt(cmd.substr(0, 1));
         if (op == OP_NONE) {
+            batcherror("invalid macro: " + macropart);
             return;
         }
 
@@ -552,29 +1865,153 @@ void Program::execmacro(const string &str)
     }
 }
 
+string Program::expandcmd(const string &str) const
+{
+    /* the queue may hold thousands of packages, their names are joined once */
+    size_t len = 0;
+    for (const Package *p : opqueue) {
+        len += p->getstrattr(A_NAME).length() + 1;
+    }
+    string pkgs;
+    pkgs.reserve(len);
+    for (const Package *p : opqueue) {
+        const boost::string_ref name = p->getstrattr(A_NAME);
+        pkgs.append(name.data(), name.length());
+        pkgs += ' ';
+    }
+
+    const string needle = "%p";
+    string processed_str;
+    size_t start = 0,
+           pos;
+    while ((pos = str.find(needle, start)) != string::npos) {
+        processed_str.append(str, start, pos - start);
+        processed_str += pkgs;
+        start = pos + needle.length();
+    }
+    processed_str.append(str, start, string::npos);
+
+    return processed_str;
+}
+
 void Program::execmd(const string &str)
 {
     gethis(OP_EXEC)->add(str);
 
-    string pkgs = "";
+    const string processed_str = expandcmd(str);
+
+    /* the windows are kept, the terminal is only lent to the command */
+    CursesUi::ui().suspend();
+    run_cmd(processed_str);
+    CursesUi::ui().resume();
+}
+
+void Program::execbg(const string &str)
+{
+    gethis(OP_EXEC_BG)->add(str);
+
+    if (command.busy()) {
+        state.message = "a command is still running (%exec_kill stops it)";
+        return;
+    }
+
+    state.outputcmd = expandcmd(str);
+    state.outputstatus = "running";
+    state.output.clear();
+    state.outputversion++;
+    state.outputscroll = 0;
+    state.showoutput = true;
+
+    command.start(state.outputcmd);
+}
+
+bool Program::pollcommand()
+{
+    /* older lines are dropped beyond this */
+    const size_t maxlines = 10000;
+
+    if (!command.busy()) {
+        return false;
+    }
+
+    const size_t before = state.output.size();
+    string status;
+    const bool finished = command.poll(state.output, status);
+
+    if (state.output.size() > maxlines) {
+        state.output.erase(state.output.begin(), state.output.end() - maxlines);
+    }
+    if (finished) {
+        state.outputstatus = status;
+        state.message = "command finished: " + status;
+    }
+    if (!finished && state.output.size() == before) {
+        return false;
+    }
+
+    state.outputversion++;
+    return true;
+}
+
+void Program::scrolloutput(int lines)
+{
+    const int rows = CursesUi::ui().output()->usableheight() + 1;
+    const int maxscroll = std::max<int>(0, (int)state.output.size() - rows);
+
+    state.outputscroll = std::min(std::max((int)state.outputscroll + lines, 0), maxscroll);
+}
+
+bool Program::isqueued(const Package *pkg) const
+{
+    return pkg->getindex() < queuedmask.size() && queuedmask[pkg->getindex()];
+}
+
+void Program::rebuildqueuemask()
+{
+    queuedmask.resize(packages.size());
+    queuedmask.reset();
     for (const Package *p : opqueue) {
-        pkgs += p->getname() + " ";
+        queuedmask.set(p->getindex());
     }
+}
 
-    const string needle = "%p";
-    size_t  pos;
-    string processed_str = str;
-    while ((pos = processed_str.find(needle)) != string::npos) {
-        processed_str.replace(pos, needle.length(), pkgs);
+void Program::queuefiltered(const ControlOperationEnum op)
+{
+    /* the view is the current mask applied to sortedpackages */
+    const boost::dynamic_bitset<> &filtered = currentmask();
+
+    /* queued packages stay in order, new ones are appended in view order */
+    vector<Package *> queue;
+    queue.reserve(opqueue.size() + ((op == CTRL_QUEUE_POP_FILTERED) ? 0 : filtered.count()));
+    for (Package *p : opqueue) {
+        if (op == CTRL_QUEUE_PUSH_FILTERED || !filtered[p->getindex()]) {
+            queue.push_back(p);
+        }
+    }
+    if (op != CTRL_QUEUE_POP_FILTERED) {
+        for (Package *p : sortedpackages) {
+            if (filtered[p->getindex()] && !queuedmask[p->getindex()]) {
+                queue.push_back(p);
+            }
+        }
     }
 
-    CursesUi::ui().disable_curses();
-    run_cmd(processed_str);
-    CursesUi::ui().enable_curses(&filteredpackages, &opqueue);
+    opqueue.swap(queue);
+    rebuildqueuemask();
+
+    if (!batch) {
+        CursesUi::ui().queue()->updatefocus();
+        if (opqueue.empty()) {
+            CursesUi::ui().set_focus(PANE_LIST);
+        }
+    }
+    state.message = boost::str(boost::format("%d packages queued") % opqueue.size());
 }
 
 void Program::colorcodepackages(const string &str)
 {
+    Profiler::Span span("colorcode");
+
     if (str.length() < 1) {
         return;
     }
@@ -596,167 +2033,434 @@ void Program::colorcodepackages(const string &str)
 
 void Program::colorcodepackages(const AttributeEnum attr)
 {
-    Filter::clearattrs();
+    /* groups are computed when packages are drawn (see init()) */
+    state.coloredby = attr;
+}
 
-    for (auto p : packages) {
-        Filter::assigncol(p, attr);
+void Program::showmemstats()
+{
+    StringPool::Stats stats;
+    {
+        /* the loader and lazy computations on other threads fill the pools
+           while holding the lock */
+        std::lock_guard<std::mutex> lock(Package::alpmlock());
+        stats = lazypool.getstats();
+        for (const StringPool *pool : pools) {
+            stats += pool->getstats();
+        }
     }
 
-    state.coloredby = attr;
+    state.message = boost::str(boost::format(
+                                   "%d strings (%d interned): %s instead of %s, %s in arenas")
+                               % stats.strings % stats.internhits
+                               % Package::size2str(stats.usedbytes())
+                               % Package::size2str(stats.legacybytes())
+                               % Package::size2str(stats.blockbytes));
+}
+
+void Program::showstats()
+{
+    /* the output pane is taken over, unless a command still writes to it */
+    if (command.busy()) {
+        state.message = "a command is still running (%exec_kill stops it)";
+        return;
+    }
+
+    state.outputcmd = "%stats";
+    state.outputstatus = "profile";
+    state.output.clear();
+    Profiler::report(state.output);
+    state.outputscroll = 0;
+    state.outputversion++;
+    state.showoutput = true;
 }
 
 void Program::searchpackages(const string &str)
 {
-    string fieldlist, searchphrase;
+    Profiler::Span span("search");
 
     gethis(OP_SEARCH)->add(str);
 
-    /* first, split actual search phrase from field prefix */
-    sregex reprefix = sregex::compile("^([A-Za-z]*):(.*)");
-    smatch what;
+    try {
+        const Query query(str);
 
-    Filter::clearattrs();
-    if (regex_search(str, what, reprefix)) {
-        fieldlist = what[1];
-        searchphrase = what[2];
-        Filter::setattrs(fieldlist);
-    } else {
-        searchphrase = str;
-    }
+        /* if search phrase is empty, nothing to do */
+        if (query.empty()) {
+            return;
+        }
 
-    /* if search phrase is empty, nothing to do */
-    if (searchphrase.length() == 0) {
+        searchquery = str;
+        findmatches(query);
+    } catch (const PcursesException &e) {
+        /* invalid search expressions are reported in the status bar */
+        state.message = e.getmessage();
         return;
     }
 
-    const auto search_by_phrase = [&searchphrase] (const Package *a) {
-        return Filter::matches(a, searchphrase);
-    };
-
     /* we start the search at the current package */
-    vector<Package *>::iterator begin = filteredpackages.begin() + CursesUi::ui().list()->focusedindex()
-                                        + 1;
-    vector<Package *>::iterator it;
+    searchstep(1);
+}
+
+void Program::findmatches(const Query &query)
+{
+    /* the view is a subset of the current mask, even while a live
+       filter is shown */
+    const boost::dynamic_bitset<> &base = currentmask();
+    boost::dynamic_bitset<> mask(packages.size());
+
+    buildsearchindex(query);
+
+    query.select(packages, base, &searchindex, workers(base.count()), mask);
 
-    it = std::find_if(begin, filteredpackages.end(), search_by_phrase);
+    searchmatches.clear();
+    for (size_t i = 0; i < filteredpackages.size(); i++) {
+        if (mask[filteredpackages[i]->getindex()]) {
+            searchmatches.push_back(i);
+        }
+    }
+    searchstale = false;
+}
+
+void Program::searchstep(int dir)
+{
+    if (searchquery.empty()) {
+        state.message = "nothing has been searched for yet";
+        return;
+    }
 
-    /* if not found (and original search didn't start at beginning) wrap around */
-    if (it == filteredpackages.end() && begin != filteredpackages.begin()) {
-        it = std::find_if(filteredpackages.begin(), filteredpackages.end(),
-                          search_by_phrase);
+    if (searchstale) {
+        /* it has been parsed successfully before */
+        findmatches(Query(searchquery));
     }
 
-    /* not found, do nothing */
-    if (it == filteredpackages.end()) {
+    if (searchmatches.empty()) {
+        state.message = "no package matches " + searchquery;
         return;
     }
 
+    /* the matches following (or preceding) the focused package, wrapping around */
+    const size_t focused = CursesUi::ui().list()->focusedindex();
+    vector<size_t>::const_iterator it;
+    if (dir > 0) {
+        it = std::upper_bound(searchmatches.begin(), searchmatches.end(), focused);
+        if (it == searchmatches.end()) {
+            it = searchmatches.begin();
+        }
+    } else {
+        it = std::lower_bound(searchmatches.begin(), searchmatches.end(), focused);
+        if (it == searchmatches.begin()) {
+            it = searchmatches.end();
+        }
+        it--;
+    }
+
     /* move focus to found pkg */
-    CursesUi::ui().list()->moveabs(it - filteredpackages.begin());
+    CursesUi::ui().list()->moveabs(*it);
+}
+
+void Program::updatesearchstatus()
+{
+    if (searchquery.empty()) {
+        return;
+    }
+
+    /* typing a live filter changes the view all the time */
+    if (searchstale) {
+        if (state.mode != MODE_STANDARD) {
+            return;
+        }
+        findmatches(Query(searchquery));
+    }
+
+    const size_t focused = CursesUi::ui().list()->focusedindex();
+    vector<size_t>::const_iterator it =
+        std::lower_bound(searchmatches.begin(), searchmatches.end(), focused);
+
+    if (it != searchmatches.end() && *it == focused) {
+        state.search = boost::str(boost::format("%s (match %d of %d)") % searchquery
+                                  % (it - searchmatches.begin() + 1) % searchmatches.size());
+    } else {
+        state.search = boost::str(boost::format("%s (%d matches)") % searchquery
+                                  % searchmatches.size());
+    }
 }
 
 void Program::sortpackages(const string &str)
 {
+    Profiler::Span span("sort");
+
     if (str.length() < 1) {
         return;
     }
 
     gethis(OP_SORT)->add(str);
 
-    AttributeEnum attr = A_NONE;
-    uint i = 0;
+    /* every field specifier adds a sort key, '-' makes the next one descending */
+    vector<SortKey> order;
+    bool descending = false;
 
-    while (attr == A_NONE && i < str.length()) {
-        attr = AttributeInfo::chartoattr(str[i]);
-        i++;
+    for (uint i = 0; i < str.length(); i++) {
+        if (str[i] == '-') {
+            descending = true;
+            continue;
+        }
+
+        const AttributeEnum attr = AttributeInfo::chartoattr(str[i]);
+        if (attr == A_NONE) {
+            continue;
+        }
+
+        const SortKey key = { attr, descending };
+        order.push_back(key);
+        descending = false;
     }
 
-    if (attr == A_NONE) {
+    if (order.empty()) {
         return;
     }
 
-    state.sortedby = attr;
+    state.sortedby.swap(order);
 
-    std::sort(filteredpackages.begin(), filteredpackages.end(),
-              [attr] (const Package *lhs, const Package *rhs) {
-                  return Filter::cmp(lhs, rhs, attr);
-              });
+    sortall();
+    updateview();
 }
 
-void Program::filterpackages(const string &str)
+string Program::chainkey(const string &part) const
 {
-    string fieldlist, searchphrase, negate;
+    return filters.empty() ? part : filters.back().chain + '\n' + part;
+}
 
-    gethis(OP_FILTER)->add(str);
+void Program::pushfilter(const string &str, const string &chain, boost::dynamic_bitset<> &mask)
+{
+    filtercache.insertmask(chain, mask);
 
-    /* first, split actual search phrase from field prefix */
-    sregex reprefix = sregex::compile("^(([A-Za-zq]*)([!]?):)?(.*)");
-    smatch what;
+    filters.push_back(FilterLayer());
+    filters.back().query = str;
+    filters.back().chain = chain;
+    filters.back().mask.swap(mask);
 
-    Filter::clearattrs();
-    if (regex_search(str, what, reprefix)) {
-        fieldlist = what[2];
-        negate = what[3];
-        searchphrase = what[4];
-    } else {
-        throw PcursesException("Could not match filter regex.");
+    updateview();
+
+    /* List contents have changed, move to beginning. */
+    if (!batch) {
+        CursesUi::ui().list()->moveabs(0);
+    }
+}
+
+void Program::graphselect(const ControlOperationEnum op, const vector<string> &seeds,
+                          boost::dynamic_bitset<> &mask)
+{
+    if (op == CTRL_FILTER_ROOTDIFF) {
+        mask = rootdiffmask;
+        mask.resize(packages.size());
+        return;
+    }
+
+    if (!depgraph.isbuilt()) {
+        depgraph.build(packages);
     }
 
-    /* if search phrase is empty, nothing to do */
-    if (searchphrase.length() == 0) {
+    if (op == CTRL_FILTER_ORPHANS) {
+        depgraph.orphans(mask);
         return;
     }
 
-    if (!fieldlist.empty()) {
-        Filter::setattrs(fieldlist);
+    /* packages is sorted by name */
+    vector<uint32_t> ids;
+    for (const string &name : seeds) {
+        vector<Package *>::const_iterator it = std::lower_bound(packages.begin(),
+        packages.end(), name, [] (const Package *p, const string &s) {
+            return p->getstrattr(A_NAME) < s;
+        });
+        if (it != packages.end() && (*it)->getstrattr(A_NAME) == name) {
+            ids.push_back(it - packages.begin());
+        }
     }
 
-    /* if search phrase is alphanumeric only,
-       perform a fast and simple search, else run slower regexp search */
+    if (op == CTRL_FILTER_DEPS) {
+        depgraph.dependencies(ids, mask);
+    } else {
+        depgraph.dependents(ids, mask);
+    }
+}
 
-    sregex resimple = sregex::compile("[:alnum:]+");
+void Program::filtergraph(const ControlOperationEnum op)
+{
+    Profiler::Span span("graph filter");
 
-    /* catch invalid regex input by user */
-    try {
-        if (regex_match(searchphrase, what, resimple)) {
-            const auto matcher_fn = negate.empty() ? &Filter::notmatches
-                                                   : &Filter::matches;
-            const auto find_by_phrase = [&] (const Package *a) {
-                return matcher_fn(a, searchphrase);
-            };
+    vector<string> seeds;
+    string label = (op == CTRL_FILTER_DEPS) ? "%filter_deps" :
+                   (op == CTRL_FILTER_RDEPS) ? "%filter_rdeps" :
+                   (op == CTRL_FILTER_ORPHANS) ? "%filter_orphans" : "%filter_rootdiff";
 
-            vector<Package *>::iterator it =
-                std::find_if(filteredpackages.begin(), filteredpackages.end(),
-                             find_by_phrase);
-            while (it != filteredpackages.end()) {
-                filteredpackages.erase(it);
-                it = std::find_if(it, filteredpackages.end(), find_by_phrase);
-            }
-        } else {
-            const auto matcher_fn = negate.empty() ? &Filter::notmatchesre
-                                                   : &Filter::matchesre;
-            sregex needle = sregex::compile(searchphrase, icase);
-            const auto find_by_re = [&] (const Package *a) {
-                return matcher_fn(a, needle);
-            };
+    if (op == CTRL_FILTER_ROOTDIFF && rootversions.empty()) {
+        batcherror("there are no other roots to compare with (see -r)");
+        return;
+    }
 
-            vector<Package *>::iterator it =
-                std::find_if(filteredpackages.begin(), filteredpackages.end(),
-                             find_by_re);
-            while (it != filteredpackages.end()) {
-                filteredpackages.erase(it);
-                it = std::find_if(it, filteredpackages.end(), find_by_re);
+    if (op == CTRL_FILTER_DEPS || op == CTRL_FILTER_RDEPS) {
+        if (!opqueue.empty()) {
+            for (const Package *p : opqueue) {
+                seeds.push_back(p->getname());
             }
+            label += boost::str(boost::format(" (%d queued)") % seeds.size());
+        } else if (batch) {
+            batcherror("the queue is empty (%queue_push_filtered fills it)");
+            return;
+        } else if (CursesUi::ui().list()->focusedpackage() != NULL) {
+            seeds.push_back(CursesUi::ui().list()->focusedpackage()->getname());
+            label += " (" + seeds.back() + ")";
+        } else {
+            return;
         }
+    }
 
-        if (state.searchphrases.length() != 0) {
-            state.searchphrases += ", ";
+    string part = (op == CTRL_FILTER_DEPS) ? "%deps:" :
+                  (op == CTRL_FILTER_RDEPS) ? "%rdeps:" :
+                  (op == CTRL_FILTER_ORPHANS) ? "%orphans:" : "%rootdiff:";
+    for (const string &name : seeds) {
+        part += name + ' ';
+    }
+    const string chain = chainkey(part);
+
+    boost::dynamic_bitset<> mask;
+    const boost::dynamic_bitset<> *cached = filtercache.findmask(chain);
+    if (cached != NULL) {
+        mask = *cached;
+    } else {
+        mask.resize(packages.size());
+        graphselect(op, seeds, mask);
+        mask &= currentmask();
+    }
+
+    pushfilter(label, chain, mask);
+    filters.back().graphop = op;
+    filters.back().seeds.swap(seeds);
+
+    state.message = boost::str(boost::format("%d packages selected")
+                               % filters.back().mask.count());
+}
+
+void Program::updatelivefilter()
+{
+    const string str = state.inputbuf.getcontents();
+
+    if (!conf.getlivefilter() || str == livesubmitted) {
+        return;
+    }
+    livesubmitted = str;
+
+    Query *query;
+    try {
+        query = new Query(str);
+    } catch (const PcursesException &) {
+        /* incomplete expressions are common while typing */
+        return;
+    }
+
+    if (query->empty()) {
+        delete query;
+        livefilter.cancel();
+        if (liveactive) {
+            liveactive = false;
+            updateview();
+            CursesUi::ui().list()->moveabs(0);
         }
-        state.searchphrases += str;
+        return;
+    }
 
-        /* List contents have changed, move to beginning. */
+    /* a filter which has been applied before is shown right away */
+    const boost::dynamic_bitset<> *cached = filtercache.findmask(chainkey(query->normalized()));
+    if (cached != NULL) {
+        delete query;
+        livefilter.cancel();
+        livemask = *cached;
+        livequery = str;
+        liveactive = true;
+        updateview();
         CursesUi::ui().list()->moveabs(0);
-    } catch (const boost::xpressive::regex_error &e) {
-        /* we don't have any decent feedback mechanisms, so ignore faulty regexp */
+        return;
+    }
+
+    buildsearchindex(*query);
+
+    const boost::dynamic_bitset<> &base = currentmask();
+    livefilter.submit(query, str, &packages, &base,
+                      conf.getsearchindex() ? &searchindex : NULL, workers(base.count()));
+}
+
+void Program::buildsearchindex(const Query &query)
+{
+    if (!conf.getsearchindex() || !query.usesindex() || searchindex.isbuilt()) {
+        return;
+    }
+
+    /* a live filter job may still be reading the index */
+    livefilter.cancel();
+    searchindex.build(packages);
+}
+
+bool Program::polllivefilter()
+{
+    string str;
+
+    if (state.mode != MODE_INPUT || !livefilter.poll(str, livemask)) {
+        return false;
+    }
+
+    livequery = str;
+    liveactive = true;
+    updateview();
+    CursesUi::ui().list()->moveabs(0);
+    return true;
+}
+
+void Program::stoplivefilter()
+{
+    livefilter.cancel();
+    livesubmitted.clear();
+
+    if (liveactive) {
+        liveactive = false;
+        livemask.clear();
+        updateview();
+    }
+}
+
+void Program::filterpackages(const string &str)
+{
+    Profiler::Span span("filter");
+
+    gethis(OP_FILTER)->add(str);
+
+    try {
+        const Query query(str);
+
+        /* if search phrase is empty, nothing to do */
+        if (query.empty()) {
+            return;
+        }
+
+        /* filters applied again are taken from the cache */
+        const string chain = chainkey(query.normalized());
+        const boost::dynamic_bitset<> *cached = filtercache.findmask(chain);
+        if (cached != NULL) {
+            boost::dynamic_bitset<> mask(*cached);
+            pushfilter(str, chain, mask);
+            return;
+        }
+
+        /* only packages which passed all previous filters need to be looked at */
+        const boost::dynamic_bitset<> &current = currentmask();
+        boost::dynamic_bitset<> mask(packages.size());
+
+        buildsearchindex(query);
+
+        query.select(packages, current, &searchindex, workers(current.count()), mask);
+
+        pushfilter(str, chain, mask);
+    } catch (const PcursesException &e) {
+        /* invalid filter expressions are reported in the status bar */
+        batcherror(e.getmessage());
     }
 }
@@ -18,11 +18,33 @@
 #ifndef PROGRAM_H
 #define PROGRAM_H
 
+#include <atomic>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "batchoutput.h"
+#include "command.h"
 #include "config.h"
+#include "dbwatcher.h"
+#include "depgraph.h"
+#include "filtercache.h"
 #include "history.h"
+#include "livefilter.h"
+#include "loader.h"
+#include "snapshot.h"
+#include "sortcache.h"
 #include "state.h"
+#include "stringpool.h"
+#include "trigramindex.h"
 
 class Package;
+class Query;
+
+typedef struct __alpm_handle_t alpm_handle_t;
+typedef struct __alpm_pkg_t alpm_pkg_t;
 
 class Program
 {
@@ -30,28 +52,130 @@ public:
     Program();
     ~Program();
 
-    void init(const char *conf_file = NULL);
+    /* in batch mode, all packages are loaded before init() returns and
+       nothing is drawn, see runbatch() */
+    void init(const char *conf_file = NULL, bool batch = false);
+
+    /* roots to compare with, in addition to the Root options. called
+       before init(). */
+    void setroots(const std::vector<std::string> &roots);
     void mainloop();
 
+    /* runs commands (as typed, for example "@macro" or "/n:foo") one after
+       the other and writes the resulting view to output. Commands which only
+       make sense with a ui are refused. Returns false if a command failed,
+       nothing is written then. */
+    bool runbatch(const std::vector<std::string> &commands, BatchOutput &output);
+
 private:
     void run_cmd(const std::string &cmd) const;
-    void loadpkgs();
+    /* run on the loader thread */
+    void loadpkgs(Loader &loader, uint threads);
+    void loadalpm(Loader &loader, uint threads);
+    void loadroots(Loader &loader, uint threads);
+    /* installed versions (by package name) of each of roots. every root is
+       read with a handle of its own, up to threads at once. */
+    typedef std::unordered_map<std::string, std::string> RootVersions;
+    void readroots(const std::vector<std::string> &roots, uint threads,
+                   std::vector<RootVersions> &out) const;
+    /* the Root options followed by the roots given by setroots() */
+    std::vector<std::string> configuredroots() const;
+    /* reads the configured roots again. returns true if roots or
+       rootversions have changed. if a root can't be read, both are kept
+       and error is set. */
+    bool reloadroots(std::string &error);
+    /* computes rootinfo and rootdiffmask from rootversions, and creates
+       placeholders for packages which are only installed in other roots.
+       sets the indices of all packages. */
+    void updaterootinfo();
+    /* removes the placeholders from packages. rootonly still tells them
+       apart until updaterootinfo() creates new ones. */
+    void droprootonly();
+    /* takes over what the loader has finished so far */
+    bool pollloader();
+    void addpackages(std::vector<Loader::Batch> &batches);
+    void reapplyfilters();
+    /* picks up changed dbs, keeping everything else in place */
+    void reload();
+    /* patches packages for dbs whose state is now stamps */
+    void reloaddbs(const Snapshot::Stamps &stamps);
+    /* brings everything derived from packages up to date after they
+       have been patched, staying on the package named focusedname */
+    void refreshpackages(const std::string &focusedname);
+    /* reloads the dbs once the watcher has seen them change */
+    bool pollwatcher();
+    void startsnapshotwriter();
+    /* cancels the snapshot writer and waits for it */
+    void stopsnapshotwriter();
+    void openhandle();
+    /* finds local packages for packages loaded from the snapshot */
+    alpm_pkg_t *resolvelocal(boost::string_ref name);
     void init_misc();
     void deinit();
     void clearfilter();
+    void popfilter();
+    const boost::dynamic_bitset<> &currentmask();
+    void sortall();
+    void updateview();
+    /* number of threads to use for work on n packages */
+    uint workers(size_t n) const;
+    /* chain is the cache key of the filters including this one, see chainkey() */
+    void pushfilter(const std::string &str, const std::string &chain,
+                    boost::dynamic_bitset<> &mask);
+    /* cache key of the current filters followed by one described by part */
+    std::string chainkey(const std::string &part) const;
+    /* builds the search index if query can use it and it isn't built yet */
+    void buildsearchindex(const Query &query);
+    /* live filtering while a filter is typed */
+    void updatelivefilter();
+    bool polllivefilter();
+    void stoplivefilter();
     void filterpackages(const std::string &str);
+    /* filters by the dependency graph, starting from the queue or the
+       focused package if the queue is empty, or by the root comparison */
+    void filtergraph(const ControlOperationEnum op);
+    /* selects the packages which op relates to seeds (package names) */
+    void graphselect(const ControlOperationEnum op, const std::vector<std::string> &seeds,
+                     boost::dynamic_bitset<> &mask);
     void sortpackages(const std::string &str);
     void searchpackages(const std::string &str);
+    /* moves to the next (dir > 0) or previous match of the last search */
+    void searchstep(int dir);
+    /* finds all matches of the last search in the view */
+    void findmatches(const Query &query);
+    /* shows the focused match in the status bar, finding the matches
+       again if the view has changed */
+    void updatesearchstatus();
     ControlOperationEnum parsectrl(const std::string &str) const;
     void execctrl(const std::string &op);
     void execctrl(const ControlOperationEnum op);
     void execmacro(const std::string &str);
+    /* replaces %p in str with the names of queued packages */
+    std::string expandcmd(const std::string &str) const;
     void execmd(const std::string &str);
+    /* runs a command without leaving the ui, see pollcommand() */
+    void execbg(const std::string &str);
+    /* picks up the output of the background command */
+    bool pollcommand();
+    void scrolloutput(int lines);
+    /* queued packages are tracked in queuedmask */
+    bool isqueued(const Package *pkg) const;
+    void rebuildqueuemask();
+
+    /* applies the filtered view to the queue: pushes, pops or toggles all
+       of its packages */
+    void queuefiltered(const ControlOperationEnum op);
+
     void colorcodepackages(const std::string &str);
     void colorcodepackages(const AttributeEnum attr);
+    void showmemstats();
+    /* shows the profile in the output pane */
+    void showstats();
     void exitinputmode(FilterOperationEnum o);
     void prepinputmode(FilterOperationEnum o);
     History *gethis(FilterOperationEnum o);
+    /* reports an error in batch mode, which makes runbatch() fail */
+    void batcherror(const std::string &msg);
 
     State state;
 
@@ -59,12 +183,109 @@ private:
 
     bool quit;
 
+    /* no ui, see runbatch(). filteredpackages stays empty, the view is
+       currentmask() applied to sortedpackages */
+    bool batch,
+         batchfailed;
+
+    /* packages are added while loading is in progress. the startup macro
+       runs once everything is there */
+    Loader loader;
+    bool loading,
+         startuppending;
+
+    /* roots given by setroots(), and all roots compared with rootdir.
+       rootversions holds one entry per root. */
+    std::vector<std::string> cmdroots,
+        roots;
+    std::vector<RootVersions> rootversions;
+    /* A_ROOTS string of each package and the packages which are installed
+       in different versions (or not at all) in some roots, both indexed
+       like packages. empty without other roots. */
+    std::vector<boost::string_ref> rootinfo;
+    /* placeholders in packages, see updaterootinfo(). they live in rootpool */
+    std::unordered_set<const Package *> rootonly;
+    StringPool rootpool;
+    boost::dynamic_bitset<> rootdiffmask;
+
+    /* kept alive while packages exist, since they compute some fields lazily.
+       only opened on demand if the packages come from the snapshot. */
+    alpm_handle_t *handle;
+    /* the handle whose sync packages packages point into, NULL if none.
+       an older one than handle after reloads which only found changes
+       to the local db, see reloaddbs(). */
+    alpm_handle_t *synchandle;
+    /* memory taken up by packages which reloads have replaced */
+    size_t deadbytes;
+
+    /* kept mapped while packages exist, they point into it */
+    Snapshot snapshot;
+    std::string snapshotpath,
+        snapshotstamp;
+    /* state of the dbs the packages were loaded from */
+    Snapshot::Stamps dbstamps;
+    /* rewrites the snapshot after loading from libalpm */
+    std::thread snapshotwriter;
+    std::atomic<bool> writercancelled;
+    /* started once loading has finished, if AutoReload is enabled */
+    DbWatcher watcher;
+
+    /* backing memory of all packages, one pool per loader thread */
+    std::vector<StringPool *> pools;
+    StringPool lazypool;
+
+    /* packages is sorted by name, a package's index always refers to it.
+       sortedpackages holds the same packages sorted by state.sortedby,
+       filteredpackages (the package list view) is its subset passing all filters */
     std::vector<Package *> packages,
+        sortedpackages,
         filteredpackages,
         opqueue;
 
+    /* packages in opqueue, indexed like packages */
+    boost::dynamic_bitset<> queuedmask;
+
+    /* one entry per applied filter. masks are indexed like packages and are
+       cumulative, i.e. the last mask selects the packages passing all filters */
+    struct FilterLayer {
+        FilterLayer() : graphop(CTRL_NONE) {}
+
+        std::string query,
+            chain;
+        /* CTRL_NONE for queries, otherwise the graph filter applied
+           to seeds, see graphselect() */
+        ControlOperationEnum graphop;
+        std::vector<std::string> seeds;
+        boost::dynamic_bitset<> mask;
+    };
+
+    std::vector<FilterLayer> filters;
+    boost::dynamic_bitset<> allmask;
+
+    /* result of the filter being typed, shown instead of the last mask */
+    LiveFilter livefilter;
+    boost::dynamic_bitset<> livemask;
+    std::string livequery,
+        livesubmitted;
+    bool liveactive;
+
+    /* built on first use, indexed like packages */
+    TrigramIndex searchindex;
+    DepGraph depgraph;
+    SortCache sortcache;
+    FilterCache filtercache;
+
+    /* the last search and the ascending positions of its matches in
+       filteredpackages. searchstale is set once the view changes. */
+    std::string searchquery;
+    std::vector<size_t> searchmatches;
+    bool searchstale;
+
     std::map<std::string, std::string> macros;
 
+    /* the background command, its output goes to state.output */
+    Command command;
+
     History hisfilter,
             hissort,
             hissearch,
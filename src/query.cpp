@@ -0,0 +1,690 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "query.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/algorithm/string.hpp>
+#include <cctype>
+#include <cstring>
+
+#include "package.h"
+#include "parallel.h"
+#include "pcursesexception.h"
+#include "strsearch.h"
+#include "trigramindex.h"
+
+using boost::string_ref;
+using boost::xpressive::cregex;
+using boost::xpressive::regex_constants::icase;
+using boost::xpressive::regex_constants::syntax_option_type;
+using std::string;
+using std::vector;
+
+/* regexes are dropped all at once when the cache grows beyond this */
+static const size_t REGEXCACHESIZE = 256;
+
+/* packages per parallel work item, a multiple of the bitset block size */
+static const size_t SELECTCHUNK = 1024;
+static_assert(SELECTCHUNK % boost::dynamic_bitset<>::bits_per_block == 0,
+              "chunks must not share bitset blocks");
+
+/* patterns containing none of these are matched as plain strings */
+static const char *METACHARS = "\\^$.|?*+()[]{}";
+
+std::unordered_map<string, cregex> Query::regexcache;
+
+struct Query::Term {
+    /* enum like attributes, each with a bitmask of the values that match */
+    vector<std::pair<AttributeEnum, uint> > enums;
+    /* remaining attributes, cheapest first */
+    vector<AttributeEnum> attrs;
+
+    bool negate,
+         literal;
+
+    string pattern,
+           lneedle,
+           indexkey; /* lower case string every match contains, may be empty */
+
+    cregex re;
+};
+
+struct Query::Node {
+    TokenEnum type; /* T_TERM, T_AND or T_OR */
+    vector<Node *> children;
+    Term *term;
+    int cost;
+};
+
+/* display strings of all values of enum like attributes, indexed by
+   Package::getnumattr(). empty for all other attributes. */
+static vector<string_ref> enumvalues(AttributeEnum attr)
+{
+    vector<string_ref> v;
+
+    switch (attr) {
+    case A_INSTALLSTATE:
+        v.push_back(Package::reasontostr(IRE_EXPLICIT));
+        v.push_back(Package::reasontostr(IRE_ASDEPS));
+        v.push_back(Package::reasontostr(IRE_NOTINSTALLED));
+        break;
+    case A_UPDATESTATE:
+        v.push_back(Package::updatestatetostr(USE_NOTINSTALLED));
+        v.push_back(Package::updatestatetostr(USE_UPTODATE));
+        v.push_back(Package::updatestatetostr(USE_UPDATEAVAILABLE));
+        break;
+    case A_SIGNATURE:
+        v.push_back(Package::signaturetostr(false));
+        v.push_back(Package::signaturetostr(true));
+        break;
+    default:
+        break;
+    }
+
+    return v;
+}
+
+/* relative cost of matching a single attribute */
+static int attrcost(AttributeEnum attr, bool literal)
+{
+    int cost = literal ? 1 : 4;
+
+    switch (attr) {
+    case A_DEPENDS:
+    case A_OPTDEPENDS:
+    case A_CONFLICTS:
+    case A_PROVIDES:
+    case A_REPLACES:
+    case A_REQUIREDBY:
+    case A_OPTIONALFOR:
+    case A_VERSION:
+    case A_BUILDDATE:
+        /* may have to be computed first */
+        return cost * 4;
+    default:
+        return cost;
+    }
+}
+
+/* lower case literal string all matches of the regular expression pattern
+   start with. empty if there is none, or if pattern has alternatives. */
+static string literalprefix(const string &pattern)
+{
+    string prefix;
+
+    if (pattern.find('|') != string::npos) {
+        return prefix;
+    }
+
+    for (size_t i = (pattern[0] == '^') ? 1 : 0; i < pattern.length(); i++) {
+        const char c = pattern[i];
+
+        if (strchr(METACHARS, c) != NULL) {
+            /* the previous character is optional */
+            if ((c == '?' || c == '*' || c == '{') && !prefix.empty()) {
+                prefix.erase(prefix.length() - 1);
+            }
+            break;
+        }
+
+        prefix += tolower((unsigned char)c);
+    }
+
+    return prefix;
+}
+
+PcursesException Query::unexpected(const Token &t)
+{
+    return PcursesException("Invalid filter: unexpected " +
+                            (t.type == T_END ? string("end") : "'" + t.text + "'"));
+}
+
+Query::Query(const string &str)
+    : pos(0), root(NULL), indexable(false)
+{
+    tokenize(str, tokens);
+
+    try {
+        if (tokens[0].type != T_END) {
+            root = parseor();
+            if (tokens[pos].type != T_END) {
+                throw unexpected(tokens[pos]);
+            }
+        }
+    } catch (...) {
+        freenode(root);
+        throw;
+    }
+
+    tokens.clear();
+}
+
+Query::~Query()
+{
+    freenode(root);
+}
+
+void Query::freenode(Node *n)
+{
+    if (n == NULL) {
+        return;
+    }
+
+    for (Node *c : n->children) {
+        freenode(c);
+    }
+
+    delete n->term;
+    delete n;
+}
+
+bool Query::empty() const
+{
+    return root == NULL || (root->type == T_TERM && root->term->pattern.empty());
+}
+
+string Query::normalized() const
+{
+    string out;
+    if (root != NULL) {
+        normalize(root, out);
+    }
+    return out;
+}
+
+void Query::normalize(const Node *n, string &out)
+{
+    if (n->type != T_TERM) {
+        out += '(';
+        for (size_t i = 0; i < n->children.size(); i++) {
+            if (i != 0) {
+                out += (n->type == T_AND) ? " & " : " | ";
+            }
+            normalize(n->children[i], out);
+        }
+        out += ')';
+        return;
+    }
+
+    const Term *t = n->term;
+
+    vector<AttributeEnum> attrs = t->attrs;
+    for (const auto &e : t->enums) {
+        attrs.push_back(e.first);
+    }
+    std::sort(attrs.begin(), attrs.end());
+
+    for (AttributeEnum attr : attrs) {
+        out += AttributeInfo::attrtochar(attr);
+    }
+    if (t->negate) {
+        out += '!';
+    }
+    out += ':';
+    out += t->literal ? t->lneedle : t->pattern;
+}
+
+void Query::tokenize(const string &str, vector<Token> &tokens)
+{
+    size_t start = 0;
+
+    for (size_t i = 0; i <= str.length(); i++) {
+        TokenEnum type = T_END;
+
+        if (i < str.length()) {
+            const bool standalone = (i == 0 || isspace((unsigned char)str[i - 1])) &&
+                                    (i + 1 == str.length() || isspace((unsigned char)str[i + 1]));
+            if (!standalone) {
+                continue;
+            }
+
+            switch (str[i]) {
+            case '&': type = T_AND; break;
+            case '|': type = T_OR; break;
+            case '(': type = T_OPEN; break;
+            case ')': type = T_CLOSE; break;
+            default: continue;
+            }
+        }
+
+        const string text = boost::trim_copy(str.substr(start, i - start));
+        if (!text.empty()) {
+            Token t = { T_TERM, text };
+            tokens.push_back(t);
+        }
+
+        Token t = { type, (type == T_END) ? "" : str.substr(i, 1) };
+        tokens.push_back(t);
+        start = i + 1;
+    }
+}
+
+Query::Node *Query::parseor()
+{
+    Node *n = parseand();
+
+    if (tokens[pos].type != T_OR) {
+        return n;
+    }
+
+    Node *o = new Node();
+    o->type = T_OR;
+    o->term = NULL;
+    o->cost = n->cost;
+    o->children.push_back(n);
+
+    try {
+        while (tokens[pos].type == T_OR) {
+            pos++;
+            o->children.push_back(parseand());
+            o->cost += o->children.back()->cost;
+        }
+    } catch (...) {
+        freenode(o);
+        throw;
+    }
+
+    std::stable_sort(o->children.begin(), o->children.end(), [] (const Node *l, const Node *r) {
+        return l->cost < r->cost;
+    });
+
+    return o;
+}
+
+Query::Node *Query::parseand()
+{
+    Node *n = parseprimary();
+
+    if (tokens[pos].type != T_AND) {
+        return n;
+    }
+
+    Node *a = new Node();
+    a->type = T_AND;
+    a->term = NULL;
+    a->cost = n->cost;
+    a->children.push_back(n);
+
+    try {
+        while (tokens[pos].type == T_AND) {
+            pos++;
+            a->children.push_back(parseprimary());
+            a->cost += a->children.back()->cost;
+        }
+    } catch (...) {
+        freenode(a);
+        throw;
+    }
+
+    std::stable_sort(a->children.begin(), a->children.end(), [] (const Node *l, const Node *r) {
+        return l->cost < r->cost;
+    });
+
+    return a;
+}
+
+Query::Node *Query::parseprimary()
+{
+    const Token &t = tokens[pos];
+
+    if (t.type == T_OPEN) {
+        pos++;
+        Node *n = parseor();
+        if (tokens[pos].type != T_CLOSE) {
+            freenode(n);
+            throw PcursesException("Invalid filter: missing ')'");
+        }
+        pos++;
+        return n;
+    }
+
+    if (t.type != T_TERM) {
+        throw unexpected(t);
+    }
+
+    pos++;
+
+    Node *n = new Node();
+    n->type = T_TERM;
+    n->term = NULL;
+    n->cost = 0;
+
+    try {
+        n->term = parseterm(t.text);
+    } catch (...) {
+        delete n;
+        throw;
+    }
+
+    /* enum attributes are a table lookup and don't add to the cost */
+    for (AttributeEnum attr : n->term->attrs) {
+        n->cost += attrcost(attr, n->term->literal);
+    }
+
+    return n;
+}
+
+Query::Term *Query::parseterm(const string &str)
+{
+    Term *t = new Term();
+    string fieldlist;
+
+    /* split the search phrase from the optional [fields][!]: prefix */
+    size_t i = 0;
+    while (i < str.length() && isalpha((unsigned char)str[i])) {
+        i++;
+    }
+    const bool negate = (i < str.length() && str[i] == '!');
+    const size_t colon = negate ? i + 1 : i;
+
+    if (colon < str.length() && str[colon] == ':') {
+        fieldlist = str.substr(0, i);
+        t->negate = negate;
+        t->pattern = str.substr(colon + 1);
+    } else {
+        t->negate = false;
+        t->pattern = str;
+    }
+
+    /* defaults */
+    if (fieldlist.empty()) {
+        fieldlist += AttributeInfo::attrtochar(A_NAME);
+        fieldlist += AttributeInfo::attrtochar(A_DESC);
+    }
+
+    /* if the search phrase contains no regex syntax,
+       perform a fast and simple search, else run slower regexp search */
+    t->literal = (t->pattern.find_first_of(METACHARS) == string::npos);
+    if (t->literal) {
+        t->lneedle = boost::to_lower_copy(t->pattern);
+    } else {
+        try {
+            t->re = getregex(t->pattern, icase);
+        } catch (const boost::xpressive::regex_error &e) {
+            delete t;
+            throw PcursesException("Invalid regex: " + string(e.what()));
+        }
+    }
+
+    for (char c : fieldlist) {
+        const AttributeEnum attr = AttributeInfo::chartoattr(c);
+
+        if (attr == A_NONE) {
+            continue;
+        }
+        if (std::find(t->attrs.begin(), t->attrs.end(), attr) != t->attrs.end()) {
+            continue;
+        }
+        bool seen = false;
+        for (const auto &e : t->enums) {
+            seen |= (e.first == attr);
+        }
+        if (seen) {
+            continue;
+        }
+
+        /* enum like attributes only have a handful of possible values,
+           so they are matched once here instead of for every package */
+        const vector<string_ref> values = enumvalues(attr);
+        if (!values.empty()) {
+            uint mask = 0;
+            for (size_t v = 0; v < values.size(); v++) {
+                const bool match = t->literal ?
+                                   StrSearch::icontains(values[v], t->lneedle) :
+                                   regex_search(values[v].begin(), values[v].end(), t->re);
+                mask |= (match ? 1U : 0U) << v;
+            }
+            t->enums.push_back(std::make_pair(attr, mask));
+        } else {
+            t->attrs.push_back(attr);
+        }
+    }
+
+    const bool literal = t->literal;
+    std::stable_sort(t->attrs.begin(), t->attrs.end(), [literal] (AttributeEnum l, AttributeEnum r) {
+        return attrcost(l, literal) < attrcost(r, literal);
+    });
+
+    /* the trigram index covers name and description only */
+    bool nameordesc = !t->negate && t->enums.empty() && !t->attrs.empty();
+    for (AttributeEnum attr : t->attrs) {
+        nameordesc &= Package::haslowerattr(attr);
+    }
+    if (nameordesc) {
+        t->indexkey = t->literal ? t->lneedle : literalprefix(t->pattern);
+        if (t->indexkey.length() < TrigramIndex::MINLENGTH) {
+            t->indexkey.clear();
+        }
+        indexable |= !t->indexkey.empty();
+    }
+
+    return t;
+}
+
+const cregex &Query::getregex(const string &pattern, syntax_option_type flags)
+{
+    const string key = std::to_string((int)flags) + ":" + pattern;
+
+    std::unordered_map<string, cregex>::const_iterator it = regexcache.find(key);
+    if (it != regexcache.end()) {
+        return it->second;
+    }
+
+    cregex re = cregex::compile(pattern, flags);
+
+    if (regexcache.size() >= REGEXCACHESIZE) {
+        regexcache.clear();
+    }
+
+    return regexcache[key] = re;
+}
+
+bool Query::candidates(const TrigramIndex &index, vector<uint32_t> &out) const
+{
+    return root != NULL && nodecandidates(root, index, out);
+}
+
+bool Query::nodecandidates(const Node *n, const TrigramIndex &index, vector<uint32_t> &out)
+{
+    vector<uint32_t> child, merged;
+    bool constrained = false;
+
+    switch (n->type) {
+    case T_AND:
+        /* any constrained child narrows down the whole conjunction */
+        for (const Node *c : n->children) {
+            if (!nodecandidates(c, index, child)) {
+                continue;
+            }
+            if (!constrained) {
+                out.swap(child);
+                constrained = true;
+            } else {
+                merged.clear();
+                std::set_intersection(out.begin(), out.end(), child.begin(), child.end(),
+                                      std::back_inserter(merged));
+                out.swap(merged);
+            }
+        }
+        return constrained;
+    case T_OR:
+        out.clear();
+        for (const Node *c : n->children) {
+            if (!nodecandidates(c, index, child)) {
+                return false;
+            }
+            merged.clear();
+            std::set_union(out.begin(), out.end(), child.begin(), child.end(),
+                           std::back_inserter(merged));
+            out.swap(merged);
+        }
+        return true;
+    default:
+        return !n->term->indexkey.empty() && index.candidates(n->term->indexkey, out);
+    }
+}
+
+bool Query::matches(const Package *p) const
+{
+    return root == NULL || eval(root, p);
+}
+
+bool Query::eval(const Node *n, const Package *p)
+{
+    switch (n->type) {
+    case T_AND:
+        for (const Node *c : n->children) {
+            if (!eval(c, p)) {
+                return false;
+            }
+        }
+        return true;
+    case T_OR:
+        for (const Node *c : n->children) {
+            if (eval(c, p)) {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return evalterm(n->term, p);
+    }
+}
+
+bool Query::evalterm(const Term *t, const Package *p)
+{
+    bool found = false;
+
+    for (const auto &e : t->enums) {
+        if ((e.second >> p->getnumattr(e.first)) & 1) {
+            found = true;
+            break;
+        }
+    }
+
+    for (size_t i = 0; !found && i < t->attrs.size(); i++) {
+        const AttributeEnum attr = t->attrs[i];
+
+        if (t->literal) {
+            found = Package::haslowerattr(attr) ?
+                    StrSearch::contains(p->getlowerattr(attr), t->lneedle) :
+                    StrSearch::icontains(p->getstrattr(attr), t->lneedle);
+        } else {
+            const string_ref s = p->getstrattr(attr);
+            found = regex_search(s.begin(), s.end(), t->re);
+        }
+    }
+
+    return found != t->negate;
+}
+
+bool Query::select(const vector<Package *> &packages, const boost::dynamic_bitset<> &base,
+                   const TrigramIndex *index, uint threads, boost::dynamic_bitset<> &mask,
+                   const std::function<bool()> &stop) const
+{
+    std::atomic<bool> stopped(false);
+    const auto checkstop = [&stop, &stopped] () {
+        if (stop && !stopped && stop()) {
+            stopped = true;
+        }
+        return stopped.load();
+    };
+
+    vector<uint32_t> candidates;
+
+    if (index != NULL && index->isbuilt() && this->candidates(*index, candidates)) {
+        /* candidates are scattered, collect the results before setting bits */
+        vector<char> matched(candidates.size());
+        Parallel::for_each_chunk(candidates.size(), threads, SELECTCHUNK,
+        [&] (size_t begin, size_t end, uint) {
+            if (checkstop()) {
+                return;
+            }
+            for (size_t c = begin; c < end; c++) {
+                const uint32_t i = candidates[c];
+                matched[c] = base[i] && matches(packages[i]);
+            }
+        });
+        if (stopped) {
+            return false;
+        }
+        for (size_t c = 0; c < candidates.size(); c++) {
+            mask[candidates[c]] = matched[c];
+        }
+        return true;
+    }
+
+    /* chunks cover whole blocks of the mask, so that workers never
+       write to the same block */
+    Parallel::for_each_chunk(packages.size(), threads, SELECTCHUNK,
+    [&] (size_t begin, size_t end, uint) {
+        if (checkstop()) {
+            return;
+        }
+        for (size_t i = (begin == 0) ? base.find_first() : base.find_next(begin - 1);
+             i < end; i = base.find_next(i)) {
+            mask[i] = matches(packages[i]);
+        }
+    });
+
+    return !stopped;
+}
+
+bool Query::termrefines(const Term *t, const Term *older)
+{
+    if (t->negate || older->negate || !t->literal || !older->literal) {
+        return false;
+    }
+    if (t->attrs != older->attrs || t->enums.size() != older->enums.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < t->enums.size(); i++) {
+        if (t->enums[i].first != older->enums[i].first) {
+            return false;
+        }
+    }
+
+    /* anything containing the longer phrase contains the shorter one */
+    return t->lneedle.find(older->lneedle) != string::npos;
+}
+
+bool Query::refines(const Query &older) const
+{
+    if (older.root == NULL) {
+        return true;
+    }
+    if (root == NULL || older.root->type != T_TERM) {
+        return false;
+    }
+
+    if (root->type == T_TERM) {
+        return termrefines(root->term, older.root->term);
+    }
+
+    /* a conjunction refines older if one of its terms does */
+    if (root->type == T_AND) {
+        for (const Node *c : root->children) {
+            if (c->type == T_TERM && termrefines(c->term, older.root->term)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,133 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/xpressive/xpressive.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "attributeinfo.h"
+
+class Package;
+class PcursesException;
+class TrigramIndex;
+
+/* A compiled filter expression. Terms have the form [fields][!]:pattern,
+   where fields default to name and description and '!' negates the term.
+   Terms can be combined with '&' (binding tighter) and '|' and grouped
+   with '(' and ')'. Operators and parentheses must be separated
+   from terms by whitespace, for example "( n:lib | n:perl ) & t:exp".
+
+   Patterns without regex syntax are matched as case insensitive substrings,
+   all others as case insensitive regular expressions. Evaluation is thread
+   safe and checks cheap terms before expensive ones. */
+class Query
+{
+public:
+    /* Throws a PcursesException if str is not a valid query. */
+    Query(const std::string &str);
+    ~Query();
+
+    bool matches(const Package *p) const;
+
+    /* true if the query has no terms, or only a single empty one */
+    bool empty() const;
+
+    /* true if some term can be looked up in a TrigramIndex */
+    bool usesindex() const
+    {
+        return indexable;
+    }
+
+    /* Stores the sorted positions of all packages which may match in out,
+       using index. Returns false if all packages have to be checked. */
+    bool candidates(const TrigramIndex &index, std::vector<uint32_t> &out) const;
+
+    /* Sets the bits of all packages which are selected by base and match in
+       mask, which must be sized like packages. Uses index (if not NULL) and up
+       to threads threads. stop (if set) is checked regularly, once it returns
+       true evaluation is abandoned and false is returned. */
+    bool select(const std::vector<Package *> &packages, const boost::dynamic_bitset<> &base,
+                const TrigramIndex *index, uint threads, boost::dynamic_bitset<> &mask,
+                const std::function<bool()> &stop = std::function<bool()>()) const;
+
+    /* true if every package matching this query also matches older, e.g.
+       because a phrase has been extended. conservative. */
+    bool refines(const Query &older) const;
+
+    /* canonical form of the query: equal for queries which only differ in
+       whitespace, case of literal phrases or the order of fields */
+    std::string normalized() const;
+
+private:
+    Query(const Query &);
+    Query &operator=(const Query &);
+
+    struct Term;
+    struct Node;
+
+    enum TokenEnum {
+        T_TERM,
+        T_AND,
+        T_OR,
+        T_OPEN,
+        T_CLOSE,
+        T_END
+    };
+
+    struct Token {
+        TokenEnum type;
+        std::string text;
+    };
+
+    static void tokenize(const std::string &str, std::vector<Token> &tokens);
+    static PcursesException unexpected(const Token &t);
+
+    Node *parseor();
+    Node *parseand();
+    Node *parseprimary();
+    Term *parseterm(const std::string &str);
+
+    static bool nodecandidates(const Node *n, const TrigramIndex &index,
+                               std::vector<uint32_t> &out);
+    static bool termrefines(const Term *t, const Term *older);
+    static void normalize(const Node *n, std::string &out);
+    static bool eval(const Node *n, const Package *p);
+    static bool evalterm(const Term *t, const Package *p);
+    static void freenode(Node *n);
+
+    /* compiled regexes are shared between queries. not thread safe, only
+       used while compiling. */
+    static const boost::xpressive::cregex &getregex(const std::string &pattern,
+            boost::xpressive::regex_constants::syntax_option_type flags);
+    static std::unordered_map<std::string, boost::xpressive::cregex> regexcache;
+
+    std::vector<Token> tokens;
+    size_t pos;
+
+    Node *root;
+
+    bool indexable;
+};
+
+#endif // QUERY_H
@@ -0,0 +1,410 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "snapshot.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/format.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "config.h"
+#include "package.h"
+#include "sortcache.h"
+#include "stringpool.h"
+#include "strsearch.h"
+
+using boost::string_ref;
+using std::string;
+using std::vector;
+
+/* bumped whenever the layout below changes */
+static const uint32_t FORMATVERSION = 1;
+static const char MAGIC[8] = { 'p', 'c', 'u', 'r', 's', 'n', 'a', 'p' };
+
+/* all strings of a package, in the order they are stored */
+static string_ref Package::Fields::* const STRINGFIELDS[] = {
+    &Package::Fields::name,
+    &Package::Fields::url,
+    &Package::Fields::packager,
+    &Package::Fields::desc,
+    &Package::Fields::version,
+    &Package::Fields::dbname,
+    &Package::Fields::arch,
+    &Package::Fields::licenses,
+    &Package::Fields::groups,
+    &Package::Fields::sizestr,
+    &Package::Fields::signature,
+    &Package::Fields::installsizestr,
+    &Package::Fields::localversion,
+    &Package::Fields::lname,
+    &Package::Fields::ldesc,
+    &Package::Fields::depends,
+    &Package::Fields::versionstr,
+    &Package::Fields::builddatestr,
+    &Package::Fields::optdepends,
+    &Package::Fields::conflicts,
+    &Package::Fields::provides,
+    &Package::Fields::replaces
+};
+
+static const size_t NSTRINGS = sizeof(STRINGFIELDS) / sizeof(STRINGFIELDS[0]);
+
+/* The file consists of the header, the stamp, one record per package, the
+   version keys and the string table, each part aligned to 8 bytes. Strings
+   are NUL terminated and the table is followed by StrSearch::PADDING zeroes.
+   Everything is in host byte order, snapshots are not meant to be shared. */
+struct Snapshot::Header {
+    char magic[8];
+    uint32_t formatversion,
+             recordsize,
+             count,
+             stamplength;
+    uint64_t stampoffset,
+             recordsoffset,
+             keysoffset,
+             stringsoffset,
+             stringslength,
+             filesize;
+};
+
+struct Snapshot::Record {
+    struct {
+        uint32_t offset,
+                 length;
+    } strings[NSTRINGS];
+
+    int64_t size,
+            installsize,
+            builddate;
+
+    uint32_t updatestate,
+             reason;
+};
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+Snapshot::Snapshot()
+    : data(NULL), size(0)
+{
+}
+
+Snapshot::~Snapshot()
+{
+    close();
+}
+
+const Snapshot::Header *Snapshot::header() const
+{
+    return (const Header *)data;
+}
+
+const Snapshot::Record *Snapshot::records() const
+{
+    return (const Record *)(data + header()->recordsoffset);
+}
+
+string Snapshot::path()
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg != NULL && xdg[0] != '\0') {
+        return string(xdg) + "/pcurses/packages.snapshot";
+    } else if (home != NULL && home[0] != '\0') {
+        return string(home) + "/.cache/pcurses/packages.snapshot";
+    }
+
+    return "";
+}
+
+static string statstamp(const string &path)
+{
+    struct stat st;
+
+    if (stat(path.c_str(), &st) != 0) {
+        return "missing";
+    }
+
+    return boost::str(boost::format("%d.%09d %d")
+                      % st.st_mtim.tv_sec % st.st_mtim.tv_nsec % st.st_size);
+}
+
+Snapshot::Stamps Snapshot::dbstamps(const Config &conf)
+{
+    const string dbpath = conf.getdbpath();
+    Stamps stamps;
+
+    for (const string &repo : conf.getrepos()) {
+        stamps[repo] = statstamp(dbpath + "/sync/" + repo + ".db");
+    }
+
+    /* changing an install reason only touches the package's desc file,
+       so all of them are looked at */
+    const string localpath = dbpath + "/local";
+    stamps["local"] = statstamp(localpath);
+    DIR *dir = opendir(localpath.c_str());
+    if (dir != NULL) {
+        struct dirent *e;
+        while ((e = readdir(dir)) != NULL) {
+            if (e->d_name[0] == '.') {
+                continue;
+            }
+            stamps[string("local/") + e->d_name] =
+                statstamp(localpath + "/" + e->d_name + "/desc");
+        }
+        closedir(dir);
+    }
+
+    return stamps;
+}
+
+string Snapshot::stamp(const Config &conf, const Stamps &stamps)
+{
+    string s = "root " + conf.getrootdir() + "\ndbpath " + conf.getdbpath() + "\n";
+
+    for (const string &repo : conf.getrepos()) {
+        const Stamps::const_iterator it = stamps.find(repo);
+        s += repo + " " + ((it == stamps.end()) ? "missing" : it->second) + "\n";
+    }
+
+    /* the local entries are summed up */
+    uint64_t sum = 0,
+             entries = 0;
+    for (const auto &st : stamps) {
+        if (boost::starts_with(st.first, "local/")) {
+            sum += StringPool::Hash()(st.first.substr(6) + " " + st.second);
+            entries++;
+        }
+    }
+    const Stamps::const_iterator local = stamps.find("local");
+    s += boost::str(boost::format("local %s %d %x\n")
+                    % ((local == stamps.end()) ? "missing" : local->second) % entries % sum);
+
+    return s;
+}
+
+bool Snapshot::open(const string &path, const string &stamp)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        return false;
+    }
+
+    data = (const char *)m;
+    size = st.st_size;
+
+    /* everything the packages will point to is checked here */
+    const Header *h = header();
+    bool valid = memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 h->formatversion == FORMATVERSION &&
+                 h->recordsize == sizeof(Record) &&
+                 h->filesize == size &&
+                 h->stampoffset + h->stamplength <= size &&
+                 h->recordsoffset + (uint64_t)h->count * sizeof(Record) <= size &&
+                 h->keysoffset + (uint64_t)h->count * sizeof(int64_t) <= size &&
+                 h->stringsoffset + h->stringslength + StrSearch::PADDING <= size &&
+                 h->recordsoffset % 8 == 0 && h->keysoffset % 8 == 0;
+
+    valid = valid && string_ref(data + h->stampoffset, h->stamplength) == stamp;
+
+    for (uint32_t i = 0; valid && i < h->count; i++) {
+        for (size_t j = 0; j < NSTRINGS; j++) {
+            const uint64_t end = (uint64_t)records()[i].strings[j].offset +
+                                 records()[i].strings[j].length;
+            valid &= (end < h->stringslength);
+        }
+        valid &= records()[i].updatestate <= USE_UPDATEAVAILABLE &&
+                 records()[i].reason <= IRE_NOTINSTALLED;
+    }
+
+    if (!valid) {
+        close();
+    }
+
+    return valid;
+}
+
+void Snapshot::close()
+{
+    if (data != NULL) {
+        munmap((void *)data, size);
+    }
+
+    data = NULL;
+    size = 0;
+}
+
+size_t Snapshot::count() const
+{
+    return isopen() ? header()->count : 0;
+}
+
+Package *Snapshot::createpackage(size_t i, StringPool &pool, StringPool &lazypool) const
+{
+    const Record &r = records()[i];
+    const char *strings = data + header()->stringsoffset;
+    Package::Fields f;
+
+    for (size_t j = 0; j < NSTRINGS; j++) {
+        f.*STRINGFIELDS[j] = string_ref(strings + r.strings[j].offset, r.strings[j].length);
+    }
+
+    f.size = r.size;
+    f.installsize = r.installsize;
+    f.builddate = r.builddate;
+    f.updatestate = (UpdateStateEnum)r.updatestate;
+    f.reason = (InstallReasonEnum)r.reason;
+
+    return Package::create(f, pool, lazypool);
+}
+
+void Snapshot::versionkeys(vector<int64_t> &keys) const
+{
+    const int64_t *k = (const int64_t *)(data + header()->keysoffset);
+    keys.assign(k, k + count());
+}
+
+/* creates all missing directories leading up to path */
+static bool makeparents(const string &path)
+{
+    for (size_t pos = path.find('/', 1); pos != string::npos; pos = path.find('/', pos + 1)) {
+        if (mkdir(path.substr(0, pos).c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Snapshot::write(const string &path, const string &stamp,
+                     const vector<Package *> &packages,
+                     const std::atomic<bool> &cancelled)
+{
+    if (path.empty() || !makeparents(path)) {
+        return false;
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.formatversion = FORMATVERSION;
+    h.recordsize = sizeof(Record);
+    h.count = packages.size();
+    h.stamplength = stamp.length();
+
+    /* identical strings (repo names, licenses, ...) are stored once */
+    vector<Record> records(packages.size());
+    string strings;
+    std::unordered_map<string_ref, uint32_t, StringPool::Hash> offsets;
+    StringPool scratch;
+
+    for (size_t i = 0; i < packages.size(); i++) {
+        if (cancelled) {
+            return false;
+        }
+
+        Package::Fields f;
+        packages[i]->getfields(f, scratch);
+
+        Record &r = records[i];
+        memset(&r, 0, sizeof(r));
+
+        for (size_t j = 0; j < NSTRINGS; j++) {
+            const string_ref s = f.*STRINGFIELDS[j];
+            std::unordered_map<string_ref, uint32_t, StringPool::Hash>::const_iterator it =
+                offsets.find(s);
+            if (it == offsets.end()) {
+                it = offsets.insert(std::make_pair(s, (uint32_t)strings.length())).first;
+                strings.append(s.data(), s.length());
+                strings += '\0';
+            }
+            r.strings[j].offset = it->second;
+            r.strings[j].length = s.length();
+        }
+
+        r.size = f.size;
+        r.installsize = f.installsize;
+        r.builddate = f.builddate;
+        r.updatestate = f.updatestate;
+        r.reason = f.reason;
+    }
+
+    vector<int64_t> keys;
+    SortCache::versionranks(packages, keys);
+
+    h.stampoffset = sizeof(Header);
+    h.recordsoffset = align8(h.stampoffset + h.stamplength);
+    h.keysoffset = align8(h.recordsoffset + records.size() * sizeof(Record));
+    h.stringsoffset = align8(h.keysoffset + keys.size() * sizeof(int64_t));
+    h.stringslength = strings.length();
+    h.filesize = h.stringsoffset + h.stringslength + StrSearch::PADDING;
+
+    /* written next to the final file and renamed, so that readers never
+       see a partial snapshot */
+    const string tmppath = boost::str(boost::format("%s.%d") % path % getpid());
+    std::ofstream out(tmppath.c_str(), std::ios::binary | std::ios::trunc);
+    const char zeroes[StrSearch::PADDING + 8] = { 0 };
+
+    const auto pad = [&out, &zeroes] (size_t from, size_t to) {
+        out.write(zeroes, to - from);
+    };
+
+    out.write((const char *)&h, sizeof(h));
+    out.write(stamp.data(), stamp.length());
+    pad(h.stampoffset + h.stamplength, h.recordsoffset);
+    out.write((const char *)records.data(), records.size() * sizeof(Record));
+    pad(h.recordsoffset + records.size() * sizeof(Record), h.keysoffset);
+    out.write((const char *)keys.data(), keys.size() * sizeof(int64_t));
+    pad(h.keysoffset + keys.size() * sizeof(int64_t), h.stringsoffset);
+    out.write(strings.data(), strings.length());
+    out.write(zeroes, StrSearch::PADDING);
+    out.close();
+
+    if (!out || rename(tmppath.c_str(), path.c_str()) != 0) {
+        unlink(tmppath.c_str());
+        return false;
+    }
+
+    return true;
+}
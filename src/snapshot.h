@@ -0,0 +1,96 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class Config;
+class Package;
+class StringPool;
+
+/* An on-disk copy of all package attributes, so that startup does not have
+   to go through libalpm. The file is mapped into memory, and packages
+   created from it point directly into the mapping.
+
+   A snapshot is only used if its stamp matches, which covers the sync db
+   files and the local db entries. 'Required by' and 'Optionally required by'
+   are not stored, they are computed from the local db when needed. */
+class Snapshot
+{
+public:
+    Snapshot();
+    ~Snapshot();
+
+    /* file the snapshot is kept in, empty if there is no cache directory */
+    static std::string path();
+
+    /* State of the package dbs in conf on disk: one entry per sync db,
+       "local" for the local db and "local/<entry>" per local package. */
+    typedef std::map<std::string, std::string> Stamps;
+    static Stamps dbstamps(const Config &conf);
+
+    /* describes the given state of the package dbs in conf */
+    static std::string stamp(const Config &conf, const Stamps &stamps);
+
+    /* Maps the snapshot at path, if it is valid and has the given stamp. */
+    bool open(const std::string &path, const std::string &stamp);
+
+    /* Unmaps the snapshot. Packages created from it must be gone. */
+    void close();
+
+    bool isopen() const
+    {
+        return data != NULL;
+    }
+
+    size_t count() const;
+
+    /* Creates the i-th package (in name order) in pool. */
+    Package *createpackage(size_t i, StringPool &pool, StringPool &lazypool) const;
+
+    /* A_VERSION sort keys, indexed like the packages */
+    void versionkeys(std::vector<int64_t> &keys) const;
+
+    /* Writes packages, which must be sorted by name, to path. The file is
+       replaced atomically. Fields the packages have not computed yet are
+       rendered for the file only. Returns false on failure, or once
+       cancelled is set. */
+    static bool write(const std::string &path, const std::string &stamp,
+                      const std::vector<Package *> &packages,
+                      const std::atomic<bool> &cancelled);
+
+private:
+    Snapshot(const Snapshot &);
+    Snapshot &operator=(const Snapshot &);
+
+    struct Header;
+    struct Record;
+
+    const Header *header() const;
+    const Record *records() const;
+
+    const char *data;
+    size_t size;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,230 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "sortcache.h"
+
+#include <algorithm>
+#include <boost/utility/string_ref.hpp>
+#include <unordered_map>
+
+#include "package.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "stringpool.h"
+
+using boost::string_ref;
+using std::vector;
+
+SortCache::SortCache()
+    : threads(1), threshold(0)
+{
+}
+
+void SortCache::setparallel(uint threads, size_t threshold)
+{
+    this->threads = threads;
+    this->threshold = threshold;
+}
+
+uint SortCache::sortthreads() const
+{
+    return (packages.size() >= threshold) ? threads : 1;
+}
+
+bool SortCache::isnumeric(AttributeEnum attr)
+{
+    return attr == A_SIZE || attr == A_ISIZE || attr == A_BUILDDATE;
+}
+
+void SortCache::reset(const vector<Package *> &packages)
+{
+    this->packages = packages;
+
+    for (int i = 0; i < A_NONE; i++) {
+        vector<int64_t>().swap(keycache[i]);
+        vector<Package *>().swap(sortedcache[i]);
+        vector<int>().swap(groupcache[i]);
+    }
+
+    lastorder.clear();
+    vector<Package *>().swap(lastsorted);
+}
+
+void SortCache::computeranks(AttributeEnum attr)
+{
+    vector<int64_t> &keys = keycache[attr];
+    vector<Package *> &sorted = sortedcache[attr];
+
+    /* the sorted list falls out of ranking, it is kept as well */
+    sorted = packages;
+    Parallel::stable_sort(sorted, sortthreads(), [attr] (const Package *lhs, const Package *rhs) {
+        return lhs->getstrattr(attr) < rhs->getstrattr(attr);
+    });
+
+    keys.resize(packages.size());
+
+    int64_t rank = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (i > 0 && sorted[i - 1]->getstrattr(attr) != sorted[i]->getstrattr(attr)) {
+            rank++;
+        }
+        keys[sorted[i]->getindex()] = rank;
+    }
+}
+
+void SortCache::versionranks(const vector<Package *> &packages, vector<int64_t> &keys)
+{
+    /* far fewer distinct versions than packages. their keys were encoded
+       while loading and compare bytewise, packages only compare integers */
+    std::unordered_map<string_ref, int64_t, StringPool::Hash> ranks;
+    for (const Package *p : packages) {
+        ranks.insert(std::make_pair(p->getversionkey(), 0));
+    }
+
+    vector<string_ref> versions;
+    versions.reserve(ranks.size());
+    for (const auto &r : ranks) {
+        versions.push_back(r.first);
+    }
+
+    std::sort(versions.begin(), versions.end());
+
+    for (size_t i = 0; i < versions.size(); i++) {
+        ranks[versions[i]] = i;
+    }
+
+    keys.resize(packages.size());
+    for (size_t i = 0; i < packages.size(); i++) {
+        keys[i] = ranks[packages[i]->getversionkey()];
+    }
+}
+
+void SortCache::setkeys(AttributeEnum attr, vector<int64_t> &keys)
+{
+    keycache[attr].swap(keys);
+}
+
+const vector<int64_t> &SortCache::keys(AttributeEnum attr)
+{
+    vector<int64_t> &keys = keycache[attr];
+
+    if (!keys.empty() || packages.empty()) {
+        return keys;
+    }
+
+    if (isnumeric(attr)) {
+        keys.resize(packages.size());
+        for (size_t i = 0; i < packages.size(); i++) {
+            keys[i] = packages[i]->getnumattr(attr);
+        }
+    } else if (attr == A_VERSION) {
+        versionranks(packages, keys);
+    } else {
+        computeranks(attr);
+    }
+
+    return keys;
+}
+
+const vector<int> &SortCache::groups(AttributeEnum attr)
+{
+    vector<int> &groups = groupcache[attr];
+
+    if (!groups.empty() || packages.empty()) {
+        return groups;
+    }
+
+    Profiler::Span span("color groups");
+    groups.resize(packages.size());
+
+    /* ranks of strings already number them, only their order differs */
+    const vector<int64_t> &ranks = keycache[attr];
+    if (!isnumeric(attr) && attr != A_VERSION && !ranks.empty()) {
+        vector<int> ids(packages.size(), -1);
+        int next = 0;
+        for (size_t i = 0; i < packages.size(); i++) {
+            int &id = ids[ranks[i]];
+            if (id == -1) {
+                id = next++;
+            }
+            groups[i] = id;
+        }
+        return groups;
+    }
+
+    /* strings live as long as their packages, which outlive the cache */
+    std::unordered_map<string_ref, int, StringPool::Hash> ids;
+    for (size_t i = 0; i < packages.size(); i++) {
+        groups[i] = ids.insert(std::make_pair(packages[i]->getstrattr(attr),
+                                              (int)ids.size())).first->second;
+    }
+
+    return groups;
+}
+
+const vector<Package *> &SortCache::sorted(AttributeEnum attr)
+{
+    vector<Package *> &sorted = sortedcache[attr];
+
+    if (!sorted.empty() || packages.empty()) {
+        return sorted;
+    }
+
+    const vector<int64_t> &k = keys(attr);
+
+    /* string attributes are sorted while computing their ranks */
+    if (sorted.empty()) {
+        sorted = packages;
+        Parallel::stable_sort(sorted, sortthreads(), [&k] (const Package *lhs, const Package *rhs) {
+            return k[lhs->getindex()] < k[rhs->getindex()];
+        });
+    }
+
+    return sorted;
+}
+
+const vector<Package *> &SortCache::sorted(const vector<SortKey> &order)
+{
+    if (order.size() == 1 && !order[0].descending) {
+        return sorted(order[0].attr);
+    }
+
+    if (order == lastorder && !packages.empty()) {
+        return lastsorted;
+    }
+
+    vector<const vector<int64_t> *> k;
+    for (const SortKey &key : order) {
+        k.push_back(&keys(key.attr));
+    }
+
+    lastsorted = packages;
+    Parallel::stable_sort(lastsorted, sortthreads(),
+    [&k, &order] (const Package *lhs, const Package *rhs) {
+        for (size_t i = 0; i < k.size(); i++) {
+            const int64_t l = (*k[i])[lhs->getindex()],
+                          r = (*k[i])[rhs->getindex()];
+            if (l != r) {
+                return order[i].descending ? l > r : l < r;
+            }
+        }
+        return false;
+    });
+
+    lastorder = order;
+    return lastsorted;
+}
@@ -0,0 +1,97 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef SORTCACHE_H
+#define SORTCACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "attributeinfo.h"
+
+class Package;
+
+/* one criterion of a sort order */
+struct SortKey {
+    AttributeEnum attr;
+    bool descending;
+
+    bool operator==(const SortKey &rhs) const
+    {
+        return attr == rhs.attr && descending == rhs.descending;
+    }
+};
+
+/* Per attribute sort keys and sorted package lists, computed on first use.
+   Keys are the numeric value for sizes and build date, the rank of the
+   version (in pacman's version order) for versions, and the rank of the
+   display string among all packages otherwise. */
+class SortCache
+{
+public:
+    SortCache();
+
+    /* Drops all cached data. packages must be sorted by name, with
+       Package::getindex() returning each package's position. */
+    void reset(const std::vector<Package *> &packages);
+
+    /* sort with up to threads threads once there are threshold packages */
+    void setparallel(uint threads, size_t threshold);
+
+    /* sort key of attr for every package, indexed by Package::getindex() */
+    const std::vector<int64_t> &keys(AttributeEnum attr);
+
+    /* presets the keys of attr, e.g. from a snapshot. keys is swapped in. */
+    void setkeys(AttributeEnum attr, std::vector<int64_t> &keys);
+
+    /* A_VERSION keys of packages, indexed by position. thread safe. */
+    static void versionranks(const std::vector<Package *> &packages,
+                             std::vector<int64_t> &keys);
+
+    /* color group of every package, indexed by Package::getindex().
+       packages showing the same attr string share a group, groups are
+       numbered in order of appearance */
+    const std::vector<int> &groups(AttributeEnum attr);
+
+    /* all packages stably sorted by attr */
+    const std::vector<Package *> &sorted(AttributeEnum attr);
+
+    /* all packages stably sorted by the first key, ties broken by the
+       following keys. the result of the last call is kept. */
+    const std::vector<Package *> &sorted(const std::vector<SortKey> &order);
+
+private:
+    static bool isnumeric(AttributeEnum attr);
+
+    uint sortthreads() const;
+
+    void computeranks(AttributeEnum attr);
+
+    std::vector<Package *> packages;
+
+    uint threads;
+    size_t threshold;
+
+    std::vector<int64_t> keycache[A_NONE];
+    std::vector<Package *> sortedcache[A_NONE];
+    std::vector<int> groupcache[A_NONE];
+
+    std::vector<SortKey> lastorder;
+    std::vector<Package *> lastsorted;
+};
+
+#endif // SORTCACHE_H
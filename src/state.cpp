@@ -23,9 +23,13 @@ State::
 State()
 {
     mode = MODE_STANDARD;
-    sortedby = A_NAME;
+    const SortKey byname = { A_NAME, false };
+    sortedby.assign(1, byname);
     coloredby = A_INSTALLSTATE;
     op = OP_NONE;
+    outputversion = 0;
+    showoutput = false;
+    outputscroll = 0;
 }
 
 std::string optostr(FilterOperationEnum o)
@@ -41,6 +45,8 @@ std::string optostr(FilterOperationEnum o)
         return ";";
     case OP_EXEC:
         return "!";
+    case OP_EXEC_BG:
+        return "&";
     case OP_MACRO:
         return "@";
     case OP_CTRL:
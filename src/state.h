@@ -19,9 +19,11 @@
 #define STATE_H
 
 #include <string>
+#include <vector>
 
 #include "inputbuffer.h"
 #include "attributeinfo.h"
+#include "sortcache.h"
 
 enum ModeEnum {
     MODE_STANDARD,
@@ -35,6 +37,7 @@ enum FilterOperationEnum {
     OP_SORT,
     OP_COLORCODE,
     OP_EXEC,
+    OP_EXEC_BG,
     OP_MACRO,
     OP_CTRL,
     OP_NONE
@@ -51,10 +54,27 @@ enum ControlOperationEnum {
     CTRL_QUEUE_PUSH,
     CTRL_QUEUE_POP,
     CTRL_QUEUE_CLEAR,
+    CTRL_QUEUE_PUSH_FILTERED,
+    CTRL_QUEUE_POP_FILTERED,
+    CTRL_QUEUE_INVERT,
     CTRL_HELP,
     CTRL_QUIT,
     CTRL_RELOAD,
+    CTRL_RELOAD_FULL,
     CTRL_FILTER_CLEAR,
+    CTRL_FILTER_POP,
+    CTRL_FILTER_DEPS,
+    CTRL_FILTER_RDEPS,
+    CTRL_FILTER_ORPHANS,
+    CTRL_FILTER_ROOTDIFF,
+    CTRL_SEARCH_NEXT,
+    CTRL_SEARCH_PREV,
+    CTRL_MEM_STATS,
+    CTRL_STATS,
+    CTRL_OUTPUT_TOGGLE,
+    CTRL_OUTPUT_UP,
+    CTRL_OUTPUT_DOWN,
+    CTRL_EXEC_KILL,
     CTRL_NONE,
 };
 
@@ -63,10 +83,28 @@ struct State {
 
     ModeEnum mode;
     std::string searchphrases;
+    std::string message;
+    /* what is still being loaded, empty once done */
+    std::string progress;
+    /* how long the last key press took to handle, if enabled */
+    std::string latency;
+    /* the last search and where the focused package is among its matches */
+    std::string search;
     InputBuffer inputbuf;
-    AttributeEnum sortedby,
-                  coloredby;
+    std::vector<SortKey> sortedby;
+    AttributeEnum coloredby;
     FilterOperationEnum op;
+
+    /* the last background command and its output, which is shown instead
+       of the package info if showoutput is set. outputversion changes
+       whenever the output does */
+    std::string outputcmd,
+        outputstatus;
+    std::vector<std::string> output;
+    uint outputversion;
+    bool showoutput;
+    /* number of lines scrolled back from the end of the output */
+    uint outputscroll;
 };
 
 std::string optostr(FilterOperationEnum o);
@@ -0,0 +1,181 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "stringpool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "strsearch.h"
+
+using boost::string_ref;
+using std::string;
+
+/* blocks are allocated in multiples of this size */
+static const size_t BLOCKSIZE = 64 * 1024;
+
+/* longest string kept in the small string buffer of libstdc++'s std::string */
+static const size_t SSOLENGTH = 15;
+
+StringPool::Stats::Stats()
+    : strings(0), internhits(0), requestedbytes(0), storedbytes(0),
+      longstrings(0), longbytes(0), blockbytes(0)
+{
+}
+
+size_t StringPool::Stats::usedbytes() const
+{
+    return strings * sizeof(string_ref) + storedbytes;
+}
+
+size_t StringPool::Stats::legacybytes() const
+{
+    /* every std::string is 32 bytes, long ones get their own heap chunk
+       (rounded up to 16 bytes, plus 16 bytes of malloc bookkeeping) */
+    return strings * sizeof(string) + longbytes + longstrings * (16 + 16);
+}
+
+StringPool::Stats &StringPool::Stats::operator+=(const Stats &rhs)
+{
+    strings += rhs.strings;
+    internhits += rhs.internhits;
+    requestedbytes += rhs.requestedbytes;
+    storedbytes += rhs.storedbytes;
+    longstrings += rhs.longstrings;
+    longbytes += rhs.longbytes;
+    blockbytes += rhs.blockbytes;
+    return *this;
+}
+
+StringPool::StringPool()
+    : blockpos(0), blocksize(0)
+{
+}
+
+StringPool::~StringPool()
+{
+    release();
+}
+
+size_t StringPool::Hash::operator()(const string_ref &s) const
+{
+    /* FNV-1a */
+    size_t h = 14695981039346656037ULL;
+    for (char c : s) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void *StringPool::allocate(size_t size, size_t align)
+{
+    size_t pos = (blockpos + align - 1) & ~(align - 1);
+
+    /* keep the padding in the same block, so that vectorized searches
+       may read past the end of a string */
+    if (blocks.empty() || pos + size + StrSearch::PADDING > blocksize) {
+        blocksize = std::max(BLOCKSIZE, size + align + StrSearch::PADDING);
+        blocks.push_back(new char[blocksize]);
+        stats.blockbytes += blocksize;
+        pos = 0;
+    }
+
+    blockpos = pos + size;
+    return blocks.back() + pos;
+}
+
+string_ref StringPool::store(string_ref s)
+{
+    stats.strings++;
+    stats.requestedbytes += s.size();
+    if (s.size() > SSOLENGTH) {
+        stats.longstrings++;
+        stats.longbytes += s.size();
+    }
+
+    if (s.empty()) {
+        return string_ref("", 0);
+    }
+
+    stats.storedbytes += s.size() + 1;
+
+    char *p = (char *)allocate(s.size() + 1, 1);
+    memcpy(p, s.data(), s.size());
+    p[s.size()] = '\0';
+
+    return string_ref(p, s.size());
+}
+
+string_ref StringPool::lower(string_ref s)
+{
+    string_ref::const_iterator it = std::find_if(s.begin(), s.end(), [] (char c) {
+        return c >= 'A' && c <= 'Z';
+    });
+    if (it == s.end()) {
+        return s;
+    }
+
+    stats.strings++;
+    stats.requestedbytes += s.size();
+    stats.storedbytes += s.size() + 1;
+    if (s.size() > SSOLENGTH) {
+        stats.longstrings++;
+        stats.longbytes += s.size();
+    }
+
+    char *p = (char *)allocate(s.size() + 1, 1);
+    for (size_t i = 0; i < s.size(); i++) {
+        const char c = s[i];
+        p[i] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+    p[s.size()] = '\0';
+
+    return string_ref(p, s.size());
+}
+
+string_ref StringPool::intern(string_ref s)
+{
+    std::unordered_set<string_ref, Hash>::const_iterator it = interned.find(s);
+    if (it != interned.end()) {
+        stats.strings++;
+        stats.internhits++;
+        stats.requestedbytes += s.size();
+        if (s.size() > SSOLENGTH) {
+            stats.longstrings++;
+            stats.longbytes += s.size();
+        }
+        return *it;
+    }
+
+    string_ref copy = store(s);
+    interned.insert(copy);
+    return copy;
+}
+
+void StringPool::release()
+{
+    for (char *block : blocks) {
+        delete[] block;
+    }
+
+    blocks.clear();
+    interned.clear();
+    blockpos = 0;
+    blocksize = 0;
+    stats = Stats();
+}
@@ -0,0 +1,97 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <boost/utility/string_ref.hpp>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/* An arena for package strings (and packages). Memory is handed out from
+   large blocks and only returned all at once by release() or the destructor,
+   so nothing allocated from a pool may have a non-trivial destructor.
+   Every allocation is followed by StrSearch::PADDING readable bytes.
+   A pool must not be used by several threads at the same time. */
+class StringPool
+{
+public:
+    struct Stats {
+        Stats();
+
+        /* Memory used by the strings, including their string_ref handles. */
+        size_t usedbytes() const;
+
+        /* Estimated usage if the strings were separate std::string objects. */
+        size_t legacybytes() const;
+
+        size_t strings,         /* number of store() and intern() calls */
+               internhits,      /* intern() calls answered by an existing copy */
+               requestedbytes,  /* total length of all stored strings */
+               storedbytes,     /* bytes actually copied into the arena */
+               longstrings,     /* strings too long for the std::string SSO buffer */
+               longbytes,       /* total length of these */
+               blockbytes;      /* total size of all allocated blocks */
+
+        Stats &operator+=(const Stats &rhs);
+    };
+
+    /* Hashes string contents, for use in unordered containers. */
+    struct Hash {
+        size_t operator()(const boost::string_ref &s) const;
+    };
+
+    StringPool();
+    ~StringPool();
+
+    /* Copies s into the arena. The copy is NUL terminated. */
+    boost::string_ref store(boost::string_ref s);
+
+    /* Like store(), but returns the existing copy if s has been interned
+       before. Meant for low cardinality values such as repo names. */
+    boost::string_ref intern(boost::string_ref s);
+
+    /* Returns an ASCII lower case copy of s, or s itself if it contains
+       no upper case letters. s must be stored in this pool. */
+    boost::string_ref lower(boost::string_ref s);
+
+    /* Returns uninitialized, suitably aligned memory. */
+    void *allocate(size_t size, size_t align);
+
+    /* Frees all memory handed out by this pool. */
+    void release();
+
+    const Stats &getstats() const
+    {
+        return stats;
+    }
+
+private:
+    StringPool(const StringPool &);
+    StringPool &operator=(const StringPool &);
+
+    std::vector<char *> blocks;
+    size_t blockpos,
+           blocksize;
+
+    std::unordered_set<boost::string_ref, Hash> interned;
+
+    Stats stats;
+};
+
+#endif // STRINGPOOL_H
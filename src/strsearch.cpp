@@ -0,0 +1,144 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "strsearch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRSEARCH_X86
+#include <immintrin.h>
+#endif
+
+using boost::string_ref;
+
+typedef bool (*containsfn)(const char *, size_t, const char *, size_t);
+
+static bool containsscalar(const char *h, size_t n, const char *s, size_t m)
+{
+    return std::search(h, h + n, s, s + m) != h + n;
+}
+
+#ifdef STRSEARCH_X86
+
+/* Checks every position at which the first and the last needle character
+   match. Compares 16 (32) candidate positions per step, reading at most
+   15 (31) bytes past the end of the haystack. */
+
+__attribute__((target("sse2")))
+static bool containssse2(const char *h, size_t n, const char *s, size_t m)
+{
+    const __m128i first = _mm_set1_epi8(s[0]);
+    const __m128i last = _mm_set1_epi8(s[m - 1]);
+
+    for (size_t i = 0; i + m <= n; i += 16) {
+        const __m128i bf = _mm_loadu_si128((const __m128i *)(h + i));
+        const __m128i bl = _mm_loadu_si128((const __m128i *)(h + i + m - 1));
+        uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf),
+                                      _mm_cmpeq_epi8(last, bl)));
+
+        /* discard candidates which would run past the end */
+        const size_t candidates = n - m - i + 1;
+        if (candidates < 16) {
+            mask &= (1U << candidates) - 1;
+        }
+
+        while (mask != 0) {
+            const uint k = __builtin_ctz(mask);
+            if (m <= 2 || memcmp(h + i + k + 1, s + 1, m - 2) == 0) {
+                return true;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return false;
+}
+
+__attribute__((target("avx2")))
+static bool containsavx2(const char *h, size_t n, const char *s, size_t m)
+{
+    const __m256i first = _mm256_set1_epi8(s[0]);
+    const __m256i last = _mm256_set1_epi8(s[m - 1]);
+
+    for (size_t i = 0; i + m <= n; i += 32) {
+        const __m256i bf = _mm256_loadu_si256((const __m256i *)(h + i));
+        const __m256i bl = _mm256_loadu_si256((const __m256i *)(h + i + m - 1));
+        uint mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bf),
+                                         _mm256_cmpeq_epi8(last, bl)));
+
+        const size_t candidates = n - m - i + 1;
+        if (candidates < 32) {
+            mask &= (1U << candidates) - 1;
+        }
+
+        while (mask != 0) {
+            const uint k = __builtin_ctz(mask);
+            if (m <= 2 || memcmp(h + i + k + 1, s + 1, m - 2) == 0) {
+                return true;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return false;
+}
+
+static containsfn pickkernel()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return containsavx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return containssse2;
+    }
+    return containsscalar;
+}
+
+#else
+
+static containsfn pickkernel()
+{
+    return containsscalar;
+}
+
+#endif // STRSEARCH_X86
+
+bool StrSearch::contains(string_ref haystack, string_ref needle)
+{
+    static const containsfn kernel = pickkernel();
+
+    if (needle.empty()) {
+        return true;
+    }
+    if (needle.size() > haystack.size()) {
+        return false;
+    }
+
+    return kernel(haystack.data(), haystack.size(), needle.data(), needle.size());
+}
+
+bool StrSearch::icontains(string_ref haystack, string_ref lneedle)
+{
+    return std::search(haystack.begin(), haystack.end(), lneedle.begin(), lneedle.end(),
+    [] (char h, char n) {
+        return tolower((unsigned char)h) == n;
+    }) != haystack.end();
+}
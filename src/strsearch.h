@@ -0,0 +1,43 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <boost/utility/string_ref.hpp>
+
+/* Vectorized substring search. The SSE2 or AVX2 kernel is picked once at
+   runtime, other platforms use a scalar loop. */
+class StrSearch
+{
+public:
+    /* Number of bytes after the end of a haystack the kernels may read.
+       The bytes are never used to decide a match, but must be readable. */
+    static const size_t PADDING = 32;
+
+    /* Returns true if haystack contains needle. Comparison is exact, so both
+       should already be lower case for case insensitive searching.
+       haystack must be followed by PADDING readable bytes, which holds for
+       all strings stored in a StringPool. */
+    static bool contains(boost::string_ref haystack, boost::string_ref needle);
+
+    /* Like contains(), but without the padding requirement. ASCII upper case
+       letters in haystack are folded, lneedle must already be lower case. */
+    static bool icontains(boost::string_ref haystack, boost::string_ref lneedle);
+};
+
+#endif // STRSEARCH_H
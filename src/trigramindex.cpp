@@ -0,0 +1,149 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#include "trigramindex.h"
+
+#include <algorithm>
+
+#include "package.h"
+
+using boost::string_ref;
+using std::vector;
+
+TrigramIndex::TrigramIndex()
+    : built(false)
+{
+}
+
+uint32_t TrigramIndex::trigram(const char *s)
+{
+    return ((uint32_t)(unsigned char)s[0] << 16) |
+           ((uint32_t)(unsigned char)s[1] << 8) |
+           (uint32_t)(unsigned char)s[2];
+}
+
+void TrigramIndex::clear()
+{
+    vector<uint32_t>().swap(keys);
+    vector<uint32_t>().swap(offsets);
+    vector<uint32_t>().swap(entries);
+    built = false;
+}
+
+void TrigramIndex::build(const vector<Package *> &packages)
+{
+    /* (trigram, package) pairs, packed so that sorting them groups
+       the postings of each trigram in package order */
+    vector<uint64_t> pairs;
+    vector<uint32_t> pkgtrigrams;
+
+    clear();
+
+    for (uint32_t i = 0; i < packages.size(); i++) {
+        const string_ref fields[] = { packages[i]->getlowerattr(A_NAME),
+                                      packages[i]->getlowerattr(A_DESC)
+                                    };
+
+        pkgtrigrams.clear();
+        for (const string_ref &f : fields) {
+            for (size_t j = 0; j + MINLENGTH <= f.size(); j++) {
+                pkgtrigrams.push_back(trigram(f.data() + j));
+            }
+        }
+
+        std::sort(pkgtrigrams.begin(), pkgtrigrams.end());
+        pkgtrigrams.erase(std::unique(pkgtrigrams.begin(), pkgtrigrams.end()),
+                          pkgtrigrams.end());
+
+        for (uint32_t t : pkgtrigrams) {
+            pairs.push_back(((uint64_t)t << 32) | i);
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+
+    entries.reserve(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const uint32_t t = pairs[i] >> 32;
+        if (keys.empty() || keys.back() != t) {
+            keys.push_back(t);
+            offsets.push_back(entries.size());
+        }
+        entries.push_back((uint32_t)pairs[i]);
+    }
+    offsets.push_back(entries.size());
+
+    built = true;
+}
+
+void TrigramIndex::postings(uint32_t t, const uint32_t *&begin, const uint32_t *&end) const
+{
+    vector<uint32_t>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), t);
+
+    if (it == keys.end() || *it != t) {
+        begin = end = NULL;
+        return;
+    }
+
+    const size_t k = it - keys.begin();
+    begin = entries.data() + offsets[k];
+    end = entries.data() + offsets[k + 1];
+}
+
+bool TrigramIndex::candidates(string_ref lneedle, vector<uint32_t> &out) const
+{
+    if (!built || lneedle.size() < MINLENGTH) {
+        return false;
+    }
+
+    /* posting lists of all distinct trigrams, intersected shortest first */
+    vector<std::pair<const uint32_t *, const uint32_t *> > lists;
+    vector<uint32_t> seen;
+
+    for (size_t i = 0; i + MINLENGTH <= lneedle.size(); i++) {
+        const uint32_t t = trigram(lneedle.data() + i);
+        if (std::find(seen.begin(), seen.end(), t) != seen.end()) {
+            continue;
+        }
+        seen.push_back(t);
+
+        const uint32_t *begin, *end;
+        postings(t, begin, end);
+        if (begin == end) {
+            out.clear();
+            return true;
+        }
+        lists.push_back(std::make_pair(begin, end));
+    }
+
+    std::sort(lists.begin(), lists.end(), [] (const std::pair<const uint32_t *, const uint32_t *> &l,
+    const std::pair<const uint32_t *, const uint32_t *> &r) {
+        return l.second - l.first < r.second - r.first;
+    });
+
+    out.assign(lists[0].first, lists[0].second);
+
+    vector<uint32_t> tmp;
+    for (size_t i = 1; i < lists.size() && !out.empty(); i++) {
+        tmp.clear();
+        std::set_intersection(out.begin(), out.end(), lists[i].first, lists[i].second,
+                              std::back_inserter(tmp));
+        out.swap(tmp);
+    }
+
+    return true;
+}
@@ -0,0 +1,65 @@
+/* *************************************************************************
+ *  Copyright 2010 Jakob Gruber                                            *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ************************************************************************* */
+
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <vector>
+
+class Package;
+
+/* Inverted index from all three character sequences of the lower case
+   package names and descriptions to the packages containing them.
+   Packages are identified by their position in the list passed to build(). */
+class TrigramIndex
+{
+public:
+    TrigramIndex();
+
+    void build(const std::vector<Package *> &packages);
+    void clear();
+
+    bool isbuilt() const
+    {
+        return built;
+    }
+
+    /* Stores the sorted positions of all packages whose name or description
+       may contain lneedle in out. Returns false if lneedle is too short
+       to be looked up, out is left untouched in that case. */
+    bool candidates(boost::string_ref lneedle, std::vector<uint32_t> &out) const;
+
+    /* shortest needle for which candidates() succeeds */
+    static const size_t MINLENGTH = 3;
+
+private:
+    static uint32_t trigram(const char *s);
+
+    void postings(uint32_t t, const uint32_t *&begin, const uint32_t *&end) const;
+
+    /* sorted trigram keys, postings of keys[i] are
+       entries[offsets[i]] to entries[offsets[i + 1]] */
+    std::vector<uint32_t> keys,
+        offsets,
+        entries;
+
+    bool built;
+};
+
+#endif // TRIGRAMINDEX_H